@@ -3,41 +3,208 @@
 #include "oi.h"
 #include "cmod.h"
 #include "timer.h"
+#include "irobcmd.h"
+#include "kinematics.h"
+#include "motion.h"
+#include "sched.h"
+
+// The periodic function of the blocking command currently running
+void (*drivingFunc)(void) = 0;
+
+// Run the periodic function, then send any commands it staged
+void drivingFuncFlush(void) {
+    drivingFunc();
+    irobcmdFlush();
+}
+
+// Wrappers around the timer delays that flush staged commands every period
+void drivingDelayMsFunc(uint32_t time_ms, void (*func)(void),
+        uint16_t period_ms, uint16_t cutoff_ms) {
+    void (*prevFunc)(void) = drivingFunc;
+    drivingFunc = func;
+    delayMsFunc(time_ms, &drivingFuncFlush, period_ms, cutoff_ms);
+    drivingFunc = prevFunc;
+}
+
+void drivingDelayPredicateFunc(uint8_t (*pred)(void), void (*func)(void),
+        uint16_t period_ms, uint16_t cutoff_ms) {
+    void (*prevFunc)(void) = drivingFunc;
+    drivingFunc = func;
+    delayPredicateFunc(pred, &drivingFuncFlush, period_ms, cutoff_ms);
+    drivingFunc = prevFunc;
+}
+
+void drivingDelayMsPredicateFunc(uint32_t time_ms, uint8_t (*pred)(void),
+        void (*func)(void), uint16_t period_ms, uint16_t cutoff_ms) {
+    void (*prevFunc)(void) = drivingFunc;
+    drivingFunc = func;
+    delayMsPredicateFunc(time_ms, pred, &drivingFuncFlush, period_ms,
+            cutoff_ms);
+    drivingFunc = prevFunc;
+}
+
+// # VELOCITY PROFILE #
+
+// Limits in mm/s per tick and mm/s per tick per tick (0 acceleration: off)
+uint8_t profileMaxAccel = 0;
+uint8_t profileJerk = 0;
+uint8_t profileTask = SCHED_NO_TASK;
+
+// Where the wheels should get to, and where they are. Straight drives and
+// turns on the spot are worked in wheel speeds; an arc of any other radius
+// ramps its velocity in the right slot, with the radius held.
+int16_t profileTarget[2] = { 0, 0 };
+int16_t profileVelocity[2] = { 0, 0 };
+int16_t profileAccel[2] = { 0, 0 };
+// Arc radius, or 0 for wheel speeds
+int16_t profileTargetRadius = 0;
+int16_t profileRadius = 0;
+
+#define PROFILE_RIGHT   (0)
+#define PROFILE_LEFT    (1)
+
+// Stage the profile's current velocities
+void profileStage(void) {
+    if (profileRadius == 0) {
+        irobcmdDrive(CmdDriveWheels, profileVelocity[PROFILE_RIGHT],
+                profileVelocity[PROFILE_LEFT]);
+    } else {
+        irobcmdDrive(CmdDrive, profileVelocity[PROFILE_RIGHT], profileRadius);
+    }
+}
+
+// Step one wheel toward a target under the acceleration and jerk limits
+void profileStepWheel(uint8_t wheel, int16_t target) {
+    int16_t v = profileVelocity[wheel];
+    int16_t a = profileAccel[wheel];
+    int16_t err = target - v;
+    int16_t want;
+    if (err == 0) {
+        profileAccel[wheel] = 0;
+        return;
+    }
+    // Head for full acceleration toward the target
+    want = err > 0 ? profileMaxAccel : -profileMaxAccel;
+    if (profileJerk == 0) {
+        a = want;
+    } else {
+        // Ease off once stopping the acceleration would take us to the
+        // target: that covers about a * (a + jerk) / (2 * jerk)
+        int16_t absA = a < 0 ? -a : a;
+        int16_t absErr = err < 0 ? -err : err;
+        if ((a > 0) == (err > 0) && (int32_t)absA * (absA + profileJerk)
+                >= 2 * (int32_t)profileJerk * absErr) {
+            want = 0;
+        }
+        if (a < want) {
+            a = a + profileJerk < want ? a + profileJerk : want;
+        } else if (a > want) {
+            a = a - profileJerk > want ? a - profileJerk : want;
+        }
+    }
+    v += a;
+    // Don't overshoot
+    if ((err > 0 && v >= target) || (err < 0 && v <= target)) {
+        v = target;
+        a = 0;
+    }
+    profileVelocity[wheel] = v;
+    profileAccel[wheel] = a;
+}
+
+void driveProfileStep(void) {
+    if (profileRadius != profileTargetRadius) {
+        // Changing between an arc and wheel speeds; stop first
+        profileStepWheel(PROFILE_RIGHT, 0);
+        profileStepWheel(PROFILE_LEFT, 0);
+        if (profileVelocity[PROFILE_RIGHT] == 0
+                && profileVelocity[PROFILE_LEFT] == 0) {
+            profileRadius = profileTargetRadius;
+        }
+    } else {
+        profileStepWheel(PROFILE_RIGHT, profileTarget[PROFILE_RIGHT]);
+        profileStepWheel(PROFILE_LEFT, profileTarget[PROFILE_LEFT]);
+    }
+    profileStage();
+    irobcmdFlush();
+}
+
+void driveProfileSet(uint8_t accel, uint8_t jerk) {
+    profileMaxAccel = accel;
+    profileJerk = jerk;
+    if (accel && profileTask == SCHED_NO_TASK) {
+        profileTask = schedAdd(&driveProfileStep, DRIVE_PROFILE_PERIOD_MS, 0,
+                DRIVE_PROFILE_PERIOD_MS, 0);
+    } else if (!accel && profileTask != SCHED_NO_TASK) {
+        schedRemove(profileTask);
+        profileTask = SCHED_NO_TASK;
+        driveHalt();
+    }
+}
+
+// Set the targets, and jump straight to them if the profile is off
+void profileSetTarget(int16_t right, int16_t left, int16_t radius) {
+    profileTarget[PROFILE_RIGHT] = right;
+    profileTarget[PROFILE_LEFT] = left;
+    profileTargetRadius = radius;
+    if (!profileMaxAccel) {
+        profileVelocity[PROFILE_RIGHT] = right;
+        profileVelocity[PROFILE_LEFT] = left;
+        profileAccel[PROFILE_RIGHT] = 0;
+        profileAccel[PROFILE_LEFT] = 0;
+        profileRadius = radius;
+    }
+}
 
-// Weird constants because squeezing out precision
-#define PIe5            314159
-#define TENTH_RADIUS    13
 
 // # BASIC COMMANDS #
 
 void driveDirect(uint16_t left, uint16_t right) {
-    // Send the direct drive command to the Create
-    byteTx(CmdDriveWheels);
-    uint16Tx(right);
-    uint16Tx(left);
+    profileSetTarget(right, left, 0);
+    if (!profileMaxAccel) {
+        // Stage the direct drive command for the Create
+        irobcmdDrive(CmdDriveWheels, right, left);
+    }
 }
 
 void drive(int16_t velocity, int16_t radius) {
-    // Send the start driving command to the Create
-    byteTx(CmdDrive);
-    uint16Tx(velocity);
-    uint16Tx(radius);
-    /*byteTx((uint8_t)((velocity >> 8) & 0x00FF));
-    byteTx((uint8_t)(velocity & 0x00FF));
-    byteTx((uint8_t)((radius >> 8) & 0x00FF));
-    byteTx((uint8_t)(radius & 0x00FF));*/
+    if (radius == (int16_t)RadStraight) {
+        profileSetTarget(velocity, velocity, 0);
+    } else if (radius == RadCCW) {
+        profileSetTarget(velocity, -velocity, 0);
+    } else if (radius == RadCW) {
+        profileSetTarget(-velocity, velocity, 0);
+    } else {
+        profileSetTarget(velocity, velocity, radius);
+    }
+    if (!profileMaxAccel) {
+        // Stage the start driving command for the Create
+        irobcmdDrive(CmdDrive, velocity, radius);
+    }
 }
 
 void driveStop(void) {
     drive(0, RadStraight);
 }
 
+void driveHalt(void) {
+    // Skip the profile
+    uint8_t accel = profileMaxAccel;
+    profileMaxAccel = 0;
+    driveStop();
+    profileMaxAccel = accel;
+}
+
 
 // # OPCODE-BASED COMMANDS #
 
 void driveDistanceOp(int16_t velocity, int16_t distance) {
+    // The Create won't take profile steps while it waits, so skip the profile
+    uint8_t accel = profileMaxAccel;
+    profileMaxAccel = 0;
     // Start driving
     drive(velocity, RadStraight);
+    irobcmdFlush();
     // Halt execution of new commands on the Create until reached distance
     byteTx(WaitForDistance);
     uint16Tx(distance);
@@ -45,15 +212,21 @@ void driveDistanceOp(int16_t velocity, int16_t distance) {
     byteTx((uint8_t)(distance & 0x00FF));*/
     // Stop the Create
     driveStop();
+    irobcmdFlush();
+    profileMaxAccel = accel;
 }
 
 void driveAngleOp(int16_t velocity, int16_t radius, int16_t angle) {
+    // The Create won't take profile steps while it waits, so skip the profile
+    uint8_t accel = profileMaxAccel;
+    profileMaxAccel = 0;
     // Wait for angle opcode compatibility
     if (radius == RadCW) {
         angle = -angle;
     }
     // Start driving
     drive(velocity, radius);
+    irobcmdFlush();
     // Halt execution of new commands on the Create until reached angle
     byteTx(WaitForAngle);
     uint16Tx(angle);
@@ -61,34 +234,46 @@ void driveAngleOp(int16_t velocity, int16_t radius, int16_t angle) {
     byteTx((uint8_t)(angle & 0x00FF));*/
     // Stop the Create
     driveStop();
+    irobcmdFlush();
+    profileMaxAccel = accel;
 }
 
 
 // # TIMER-BASED COMMANDS #
 
+// Size of a signed speed, distance or angle, for the kinematics
+uint16_t drivingMagnitude(int16_t value) {
+    return value < 0 ? -(uint16_t)value : value;
+}
+
 void driveDistanceTFunc(int16_t velocity, int16_t distance, void (*func)(void),
         uint16_t period_ms, uint16_t cutoff_ms) {
     // Calculate the delay
-    uint32_t time_ms = (1000 * (uint32_t)distance) / (uint32_t)velocity;
+    uint32_t time_ms = kinDistanceTimeMs(drivingMagnitude(distance),
+            drivingMagnitude(velocity));
     // Start driving
     drive(velocity, RadStraight);
+    irobcmdFlush();
     // Wait delay
-    delayMsFunc(time_ms, func, period_ms, cutoff_ms);
+    drivingDelayMsFunc(time_ms, func, period_ms, cutoff_ms);
     // Stop the Create
     driveStop();
+    irobcmdFlush();
 }
 
 void driveAngleTFunc(int16_t velocity, int16_t radius, int16_t angle,
         void (*func)(void), uint16_t period_ms, uint16_t cutoff_ms) {
     // Calculate the delay
-    uint32_t time_ms = (PIe5 * TENTH_RADIUS * (uint32_t)angle)
-        / (1800 * (uint32_t)velocity);
+    uint32_t time_ms = kinAngleTimeMs(drivingMagnitude(angle),
+            drivingMagnitude(velocity));
     // Start driving
     drive(velocity, radius);
+    irobcmdFlush();
     // Wait delay
-    delayMsFunc(time_ms, func, period_ms, cutoff_ms);
+    drivingDelayMsFunc(time_ms, func, period_ms, cutoff_ms);
     // Stop the Create
     driveStop();
+    irobcmdFlush();
 }
 
 // # PREDICATE-BASED COMMANDS #
@@ -98,10 +283,12 @@ void drivePredicateFunc(int16_t velocity, int16_t radius,
         uint16_t cutoff_ms) {
     // Start driving
     drive(velocity, radius);
+    irobcmdFlush();
     // Wait
-    delayPredicateFunc(pred, func, period_ms, cutoff_ms);
+    drivingDelayPredicateFunc(pred, func, period_ms, cutoff_ms);
     // Stop the Create
     driveStop();
+    irobcmdFlush();
 }
 
 
@@ -109,25 +296,63 @@ void driveDistancePFunc(int16_t velocity, int16_t distance,
         uint8_t (*pred)(void), void (*func)(void), uint16_t period_ms,
         uint16_t cutoff_ms) {
     // Calculate the delay
-    uint32_t time_ms = (1000 * (uint32_t)distance) / (uint32_t)velocity;
+    uint32_t time_ms = kinDistanceTimeMs(drivingMagnitude(distance),
+            drivingMagnitude(velocity));
     // Start driving
     drive(velocity, RadStraight);
+    irobcmdFlush();
     // Wait delay
-    delayMsPredicateFunc(time_ms, pred, func, period_ms, cutoff_ms);
+    drivingDelayMsPredicateFunc(time_ms, pred, func, period_ms, cutoff_ms);
     // Stop the Create
     driveStop();
+    irobcmdFlush();
 }
 
 void driveAnglePFunc(int16_t velocity, int16_t radius, int16_t angle,
         uint8_t (*pred)(void), void (*func)(void), uint16_t period_ms,
         uint16_t cutoff_ms) {
     // Calculate the delay
-    uint32_t time_ms = (PIe5 * TENTH_RADIUS * (uint32_t)angle)
-        / (1800 * (uint32_t)velocity);
+    uint32_t time_ms = kinAngleTimeMs(drivingMagnitude(angle),
+            drivingMagnitude(velocity));
     // Start driving
     drive(velocity, radius);
+    irobcmdFlush();
     // Wait delay
-    delayMsPredicateFunc(time_ms, pred, func, period_ms, cutoff_ms);
+    drivingDelayMsPredicateFunc(time_ms, pred, func, period_ms, cutoff_ms);
+    // Stop the Create
+    driveStop();
+    irobcmdFlush();
+}
+
+
+// # ODOMETRY-BASED COMMANDS #
+
+// Advance the motion queue and send what it staged. Returns true while the
+// motion is still running.
+uint8_t drivingMotionStep(void) {
+    uint8_t busy = motionStep();
+    irobcmdFlush();
+    return busy;
+}
+
+void driveDistanceOdoFunc(int16_t velocity, int16_t distance,
+        void (*func)(void), uint16_t period_ms, uint16_t cutoff_ms) {
+    // Run the move through the motion queue, waiting for it here
+    motionAbort();
+    motionEnqueueMove(velocity, distance);
+    drivingDelayPredicateFunc(&drivingMotionStep, func, period_ms, cutoff_ms);
+    // Stop the Create
+    driveStop();
+    irobcmdFlush();
+}
+
+void driveAngleOdoFunc(int16_t velocity, int16_t radius, int16_t angle,
+        void (*func)(void), uint16_t period_ms, uint16_t cutoff_ms) {
+    // Run the turn through the motion queue, waiting for it here
+    motionAbort();
+    motionEnqueueTurn(velocity, radius, angle);
+    drivingDelayPredicateFunc(&drivingMotionStep, func, period_ms, cutoff_ms);
     // Stop the Create
     driveStop();
+    irobcmdFlush();
 }
@@ -7,7 +7,8 @@
 
 //! Directly drive the Create motors.
 /*!
- *  Returns immediately.
+ *  Returns immediately. The command is staged and sent by the next
+ *  irobcmdFlush (see irobcmd.h), which drops it if nothing changed.
  *
  *  \param left     Speed of the left motor in mm/s.
  *  \param right    Speed of the right motor in mm/s.
@@ -16,7 +17,8 @@ void driveDirect(uint16_t left, uint16_t right);
 
 //! Drive at a certain speed in a certain direction.
 /*!
- *  Returns immediately.
+ *  Returns immediately. The command is staged and sent by the next
+ *  irobcmdFlush (see irobcmd.h), which drops it if nothing changed.
  *
  *  Directions: straight, clockwise, counterclockwise.
  *
@@ -26,8 +28,42 @@ void driveDirect(uint16_t left, uint16_t right);
 void drive(int16_t velocity, int16_t radius);
 
 //! Stop the robot.
+/*!
+ *  Ramps down if the velocity profile is on.
+ */
 void driveStop(void);
 
+//! Stop the robot right away, even if the velocity profile is on.
+void driveHalt(void);
+
+
+// # VELOCITY PROFILE #
+// With the profile on, drive, driveDirect and driveStop only set targets, and
+// a sched.h task steps the wheel speeds toward them every
+// DRIVE_PROFILE_PERIOD_MS under acceleration and jerk limits. Speeding up
+// and slowing down are symmetric, so timed moves still cover their distance.
+// Switching between an arc and a straight drive or turn on the spot stops
+// first. A step is integer only: two 16x16 multiplies and a few compares per
+// wheel, an estimated 150 cycles a wheel (under 20 us a tick at 18.432 MHz)
+// including staging the command.
+
+// Milliseconds between profile steps
+#ifndef DRIVE_PROFILE_PERIOD_MS
+#define DRIVE_PROFILE_PERIOD_MS (15)
+#endif
+
+//! Set the velocity profile's limits.
+/*!
+ *  \param accel        Most the speed may change in a tick in mm/s. 0 turns
+ *                      the profile off (and stops the robot).
+ *  \param jerk         Most the acceleration may change in a tick in mm/s.
+ *                      0 means no jerk limit (a plain trapezoid).
+ */
+void driveProfileSet(uint8_t accel, uint8_t jerk);
+
+//! Step the velocity profile. The task driveProfileSet registers calls this.
+void driveProfileStep(void);
+
 
 // # OPCODE-BASED COMMANDS #
 
@@ -97,4 +133,40 @@ void driveAnglePFunc(int16_t velocity, int16_t radius, int16_t angle,
         uint8_t (*pred)(void), void (*func)(void), uint16_t period_ms,
         uint16_t cutoff_ms);
 
+
+// # ODOMETRY-BASED COMMANDS #
+// These run a single motion through the motion queue (see motion.h) and wait
+// for it, so they finish on the distance or angle the Create reports.
+
+//! Drive a certain distance at a certain speed.
+/*!
+ *  Drive until odometry shows the distance was covered. Drops anything
+ *  waiting in the motion queue.
+ *
+ *  \param velocity     The speed in mm/s.
+ *  \param distance     The distance to travel in mm.
+ *  \param func         The function to execute periodically.
+ *  \param period_ms    The interval to execute the function.
+ *  \param cutoff_ms    The number of milliseconds before the end to stop
+ *                      attempting to start the function.
+ */
+void driveDistanceOdoFunc(int16_t velocity, int16_t distance,
+        void (*func)(void), uint16_t period_ms, uint16_t cutoff_ms);
+
+//! Drive a certain angle at a certain speed.
+/*!
+ *  Drive until odometry shows the angle was turned. Drops anything waiting
+ *  in the motion queue.
+ *
+ *  \param velocity     The speed in mm/s.
+ *  \param radius       Either RadCW or RadCCW (see oi.h).
+ *  \param angle        The angle to rotate in degrees.
+ *  \param func         The function to execute periodically.
+ *  \param period_ms    The interval to execute the function.
+ *  \param cutoff_ms    The number of milliseconds before the end to stop
+ *                      attempting to start the function.
+ */
+void driveAngleOdoFunc(int16_t velocity, int16_t radius, int16_t angle,
+        void (*func)(void), uint16_t period_ms, uint16_t cutoff_ms);
+
 #endif
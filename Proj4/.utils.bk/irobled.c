@@ -2,6 +2,8 @@
 #include "irobled.h"
 #include "cmod.h"
 #include "oi.h"
+#include "irobcmd.h"
+#include "irobscript.h"
 
 // The current state of the leds.
 struct {
@@ -10,6 +12,10 @@ struct {
     uint8_t intensity;
 } iroblibState;
 
+// Deferred mode, and whether the state changed since the last flush
+uint8_t irobledDeferred = 0;
+uint8_t irobledDirty = 0;
+
 void irobledCmd(uint8_t bits, uint8_t color, uint8_t intensity) {
     // Modify the state
     iroblibState.bits = bits;
@@ -20,11 +26,32 @@ void irobledCmd(uint8_t bits, uint8_t color, uint8_t intensity) {
 }
 
 void irobledUpdate(void) {
-    // Send the led command using the current state
-    byteTx(CmdLeds);
-    byteTx(iroblibState.bits);
-    byteTx(iroblibState.color);
-    byteTx(iroblibState.intensity); 
+    if (irobledDeferred) {
+        // Wait for irobledFlush
+        irobledDirty = 1;
+    } else {
+        // Stage the led command using the current state
+        irobcmdLeds(iroblibState.bits, iroblibState.color,
+                iroblibState.intensity);
+    }
+}
+
+void irobledDefer(uint8_t on) {
+    if (!on) {
+        irobledFlush();
+    }
+    irobledDeferred = on;
+}
+
+void irobledFlush(void) {
+    // A running script would ignore the command, so keep it for later
+    if (irobledDirty && !irobscriptPlaying()) {
+        irobledDirty = 0;
+        irobcmdLeds(iroblibState.bits, iroblibState.color,
+                iroblibState.intensity);
+        // Only the leds; drive commands go out with the tick
+        irobcmdFlushLeds();
+    }
 }
 
 void irobledInit(void) {
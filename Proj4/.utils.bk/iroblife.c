@@ -11,6 +11,9 @@
 #include "irobled.h"
 #include "driving.h"
 #include "irobserial.h"
+#include "irobcmd.h"
+#include "sched.h"
+#include "motion.h"
 
 void irobImplNull(void) {
 }
@@ -19,6 +22,12 @@ void (*irobInitImpl)(void) = &irobImplNull;
 void (*irobPeriodicImpl)(void) = &irobImplNull;
 void (*irobEndImpl)(void) = &irobImplNull;
 
+// Sensor-to-actuation latency
+uint16_t irobLatency = 0;
+uint16_t irobMaxLatency = 0;
+// Sequence number of the snapshot the last synced tick ran on
+uint16_t irobSequence = 0;
+
 void setIrobInitImpl(void (*func)(void)) {
     irobInitImpl = func;
 }
@@ -50,10 +59,13 @@ void irobInit(void) {
     byteTx(CmdControl);
     // We are operating in FULL mode.
     byteTx(CmdFull);
+    // The mode change reset the Create's drive and led state.
+    irobcmdInvalidate();
 
     // Make sure the robot stops. 
     // As a precaution for the robot and your grade.
     driveStop();
+    irobcmdFlush();
 
     // Play the reset song and wait while it plays.
     byteTx(CmdPlay);
@@ -62,25 +74,73 @@ void irobInit(void) {
 
     // Turn the power button on to orange.
     irobledInit();
+    irobcmdFlush();
 
     // Call the user's init function
     irobInitImpl();
+#if SENSOR_BUFFER_SIZE < Sen6Size
+    // The sensor buffer is too small to poll everything, so the project has
+    // to say what it wants. Stop rather than run with no sensors at all.
+    if (!sensingGroups()) {
+        irobEnd();
+    }
+#endif
 }
 
 void irobPeriodic(void) {
     // Call the user's periodic function
     irobPeriodicImpl();
+    // Advance any queued motion
+    motionStep();
+    // Send this tick's leds if they were deferred
+    irobledFlush();
+    // Send this tick's drive and led commands
+    irobcmdFlush();
+    // How old was the data those commands were based on?
+    irobLatency = (uint16_t)sensorAgeMs();
+    if (irobLatency > irobMaxLatency) {
+        irobMaxLatency = irobLatency;
+    }
     // Exit if the black button on the command module is pressed.
     if(UserButtonPressed) {
         irobEnd();
     }
 }
 
+void irobPeriodicSync(void) {
+    // Wait for a new snapshot, running background tasks meanwhile. Watch the
+    // sequence number, since a background task may pick the snapshot up
+    // before we see it as fresh.
+    while (sensorSequence() == irobSequence) {
+        sensingPoll();
+        if (!schedStep(SCHED_NO_CUTOFF) && sensorSequence() == irobSequence) {
+            // Sleep until the next byte or tick
+            timerIdle();
+        }
+    }
+    irobSequence = sensorSequence();
+    sensorSnapshot();
+    // Act on it immediately
+    irobPeriodic();
+}
+
+uint16_t irobLatencyMs(void) {
+    return irobLatency;
+}
+
+uint16_t irobMaxLatencyMs(void) {
+    return irobMaxLatency;
+}
+
 void irobEnd(void) {
     // Call the user's end function
     irobEndImpl();
     // Stop the Create
-    driveStop();
+    motionAbort();
+    driveHalt();
+    irobcmdFlush();
+    // Make sure the stop command actually goes out
+    txFlush();
     // Power off the Create
     powerOffRobot();
     // Exit the program
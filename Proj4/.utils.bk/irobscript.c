@@ -0,0 +1,130 @@
+#include <stdint.h>
+#include "irobscript.h"
+#include "cmod.h"
+#include "oi.h"
+#include "timer.h"
+#include "sensing.h"
+#include "irobcmd.h"
+
+// Whether the primitives count bytes or send them. Counted in 16 bits so a
+// script too long for the Create can't wrap back under ScriptMaxSize.
+uint8_t scriptSending = 0;
+uint16_t scriptLength = 0;
+// Whether the script last uploaded resumes the stream when it ends
+uint8_t scriptResumes = 0;
+// Whether a script is being played, and the sensor sequence when it started
+uint8_t scriptPlayed = 0;
+uint16_t scriptSequence = 0;
+
+void scriptByte(uint8_t value) {
+    if (scriptSending) {
+        byteTx(value);
+    } else {
+        scriptLength++;
+    }
+}
+
+void scriptUint16(uint16_t value) {
+    scriptByte(value >> 8);
+    scriptByte(value);
+}
+
+uint8_t irobscriptLoad(void (*build)(void)) {
+    uint8_t resumes = sensingStreaming();
+    // Count it
+    scriptSending = 0;
+    scriptLength = resumes ? 2 : 0;
+    build();
+    if (scriptLength > ScriptMaxSize) {
+        return 0;
+    }
+    // Send it
+    byteTx(CmdScript);
+    byteTx(scriptLength);
+    scriptSending = 1;
+    build();
+    if (resumes) {
+        // Tell us it's over by resuming the stream
+        byteTx(CmdPauseStream);
+        byteTx(StreamResume);
+    }
+    scriptSending = 0;
+    scriptResumes = resumes;
+    return 1;
+}
+
+void irobscriptPlay(void) {
+    if (scriptResumes && sensingStreaming()) {
+        // The script resumes the stream when it's done
+        sensingStreamPause();
+        scriptSequence = sensorSequence();
+        scriptPlayed = 1;
+        byteTx(CmdPlayScript);
+        sensingStreamExpect();
+    } else {
+        byteTx(CmdPlayScript);
+    }
+    irobcmdInvalidate();
+}
+
+uint8_t irobscriptPlaying(void) {
+    if (scriptPlayed && sensorSequence() != scriptSequence) {
+        scriptPlayed = 0;
+    }
+    return scriptPlayed;
+}
+
+uint8_t irobscriptWaitMs(uint32_t timeout_ms) {
+    uint32_t start = millis();
+    while (irobscriptPlaying()) {
+        if (millis() - start >= timeout_ms) {
+            // Still running; it would ignore anything we sent, so leave it
+            // to resume the stream itself
+            return 0;
+        }
+        timerIdle();
+    }
+    return 1;
+}
+
+
+// # SCRIPT PRIMITIVES #
+
+void irobscriptDrive(int16_t velocity, int16_t radius) {
+    scriptByte(CmdDrive);
+    scriptUint16(velocity);
+    scriptUint16(radius);
+}
+
+void irobscriptDriveDirect(int16_t left, int16_t right) {
+    scriptByte(CmdDriveWheels);
+    scriptUint16(right);
+    scriptUint16(left);
+}
+
+void irobscriptLeds(uint8_t bits, uint8_t color, uint8_t intensity) {
+    scriptByte(CmdLeds);
+    scriptByte(bits);
+    scriptByte(color);
+    scriptByte(intensity);
+}
+
+void irobscriptWaitTime(uint8_t tenths) {
+    scriptByte(WaitForTime);
+    scriptByte(tenths);
+}
+
+void irobscriptWaitDistance(int16_t distance) {
+    scriptByte(WaitForDistance);
+    scriptUint16(distance);
+}
+
+void irobscriptWaitAngle(int16_t angle) {
+    scriptByte(WaitForAngle);
+    scriptUint16(angle);
+}
+
+void irobscriptWaitEvent(int8_t event) {
+    scriptByte(WaitForEvent);
+    scriptByte(event);
+}
@@ -0,0 +1,91 @@
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include "kinematics.h"
+
+// The geometry constants, checked with the compiler's own arithmetic (fails
+// to compile with a negative array size if they come out wrong)
+typedef char kinArcPerDegCheck[KIN_ARC_PER_DEG_Q == 581 ? 1 : -1];
+typedef char kinRadPerDegCheck[KIN_RAD_PER_DEG_Q16 == 1144 ? 1 : -1];
+
+// Reciprocal table. Entry m - 128 is 1000 * 2^KIN_RECIP_SHIFT / m for every
+// m in 128-256, so any speed shifted into that range turns into a multiply.
+#define KIN_RECIP_SHIFT     (12)
+#define KIN_RECIP(m)        ((uint16_t)(((1000UL << KIN_RECIP_SHIFT) \
+                + (m) / 2) / (m)))
+#define KIN_RECIP4(m)       KIN_RECIP(m), KIN_RECIP((m) + 1), \
+                            KIN_RECIP((m) + 2), KIN_RECIP((m) + 3)
+#define KIN_RECIP16(m)      KIN_RECIP4(m), KIN_RECIP4((m) + 4), \
+                            KIN_RECIP4((m) + 8), KIN_RECIP4((m) + 12)
+
+const uint16_t kinRecipTable[129] PROGMEM = {
+    KIN_RECIP16(128), KIN_RECIP16(144), KIN_RECIP16(160), KIN_RECIP16(176),
+    KIN_RECIP16(192), KIN_RECIP16(208), KIN_RECIP16(224), KIN_RECIP16(240),
+    KIN_RECIP(256)
+};
+
+// (x * y) >> shift without a 64-bit product. y must be at most 2^15.
+uint32_t kinMulShift(uint32_t x, uint16_t y, uint8_t shift) {
+    uint32_t hi = (x >> 16) * y;
+    uint32_t lo = (x & 0xFFFF) * y;
+    if (shift < 16) {
+        return (hi << (16 - shift)) + (lo >> shift);
+    }
+    // Carry the bits of hi that shift out into the low half
+    uint8_t hiShift = shift - 16;
+    uint32_t carry = (hi & ((1UL << hiShift) - 1)) << 16;
+    return (hi >> hiShift) + ((lo + carry) >> shift);
+}
+
+// Time in ms to cover a KIN_Q distance at a speed
+uint32_t kinTimeMs(uint32_t distance_q, uint16_t velocity) {
+    uint8_t shift = KIN_RECIP_SHIFT + KIN_Q_SHIFT;
+    uint16_t recip;
+    if (velocity == 0) {
+        return 0;
+    }
+    if (velocity > 511) {
+        velocity = 511;
+    }
+    // Bring the speed into the table's range
+    if (velocity > 255) {
+        recip = pgm_read_word(&kinRecipTable[(velocity >> 1) - 128]);
+        if (velocity & 1) {
+            // Halfway between two entries
+            recip = (recip
+                + pgm_read_word(&kinRecipTable[(velocity >> 1) - 127])) >> 1;
+        }
+        shift++;
+    } else {
+        while (velocity < 128) {
+            velocity <<= 1;
+            shift--;
+        }
+        recip = pgm_read_word(&kinRecipTable[velocity - 128]);
+    }
+    return kinMulShift(distance_q, recip, shift);
+}
+
+uint32_t kinDistanceTimeMs(uint16_t distance, uint16_t velocity) {
+    return kinTimeMs((uint32_t)distance << KIN_Q_SHIFT, velocity);
+}
+
+uint32_t kinAngleTimeMs(uint16_t angle, uint16_t velocity) {
+    return kinTimeMs((uint32_t)angle * KIN_ARC_PER_DEG_Q, velocity);
+}
+
+uint32_t kinArcTimeMs(uint16_t angle, uint16_t radius, uint16_t velocity) {
+    // Arc length in KIN_Q mm
+    uint32_t length_q = kinMulShift((uint32_t)angle * radius,
+            KIN_RAD_PER_DEG_Q16, 16 - KIN_Q_SHIFT);
+    return kinTimeMs(length_q, velocity);
+}
+
+uint16_t kinArcMm(uint16_t angle) {
+    // Round to the nearest mm
+    return ((uint32_t)angle * KIN_ARC_PER_DEG_Q + (1 << (KIN_Q_SHIFT - 1)))
+        >> KIN_Q_SHIFT;
+}
+
+uint16_t kinWheelSpeed(uint16_t rate) {
+    return kinArcMm(rate);
+}
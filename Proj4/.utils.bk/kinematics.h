@@ -0,0 +1,73 @@
+#ifndef KINEMATICS_H
+#define KINEMATICS_H
+
+#include <stdint.h>
+
+/*
+ *  Fixed-point kinematics for the driving layer, without divisions.
+ *
+ *  The AVR has no divider, so a 32-bit division costs hundreds of cycles.
+ *  Everything here is a multiply and a shift instead: the geometry is folded
+ *  into constants at compile time, and dividing by a speed is done with a
+ *  table of reciprocals that the compiler fills in (see kinematics.c).
+ *  Results are within a millisecond or so of the exact formulas for speeds
+ *  up to 511 mm/s.
+ */
+
+// Half the distance between the wheels in mm
+#define KIN_HALF_WHEELBASE_MM   (130)
+
+// Fractional bits of a distance in KIN_Q format
+#define KIN_Q_SHIFT             (8)
+
+// Wheel travel per degree of turning on the spot, in KIN_Q mm
+// (pi * KIN_HALF_WHEELBASE_MM / 180, rounded). Every term is 32 bits, as on
+// the AVR, so pi only gets 5 digits: the product has to fit.
+#define KIN_ARC_PER_DEG_Q \
+    (((uint32_t)31416 * KIN_HALF_WHEELBASE_MM * ((uint32_t)1 << KIN_Q_SHIFT) \
+            + (uint32_t)900000) / (uint32_t)1800000)
+
+//! Get how long it takes to cover a distance at a speed.
+/*!
+ *  \param distance     The distance in mm.
+ *  \param velocity     The speed in mm/s, 1-511.
+ *  \return             The time in ms, or 0 if the speed is 0.
+ */
+uint32_t kinDistanceTimeMs(uint16_t distance, uint16_t velocity);
+
+// Radians per degree in Q16 (pi / 180, rounded), in 32 bits the same way
+#define KIN_RAD_PER_DEG_Q16 \
+    ((uint16_t)(((uint32_t)31416 * 65536 / 10000 + 90) / 180))
+
+//! Get how long it takes to turn an angle on the spot at a wheel speed.
+/*!
+ *  \param angle        The angle in degrees.
+ *  \param velocity     The wheel speed in mm/s, 1-511.
+ *  \return             The time in ms, or 0 if the speed is 0.
+ */
+uint32_t kinAngleTimeMs(uint16_t angle, uint16_t velocity);
+
+//! Get how long it takes to drive an angle around an arc at a speed.
+/*!
+ *  \param angle        The angle in degrees.
+ *  \param radius       The radius of the arc in mm.
+ *  \param velocity     The speed in mm/s, 1-511.
+ *  \return             The time in ms, or 0 if the speed is 0.
+ */
+uint32_t kinArcTimeMs(uint16_t angle, uint16_t radius, uint16_t velocity);
+
+//! Get how far each wheel travels while turning an angle on the spot.
+/*!
+ *  \param angle        The angle in degrees.
+ *  \return             The distance in mm.
+ */
+uint16_t kinArcMm(uint16_t angle);
+
+//! Get the wheel speed that turns the robot on the spot at a rate.
+/*!
+ *  \param rate         The turning rate in degrees/s.
+ *  \return             The wheel speed in mm/s.
+ */
+uint16_t kinWheelSpeed(uint16_t rate);
+
+#endif
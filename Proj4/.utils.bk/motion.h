@@ -0,0 +1,73 @@
+#ifndef MOTION_H
+#define MOTION_H
+
+#include <stdint.h>
+
+/*
+ *  Non-blocking motion queue.
+ *
+ *  The enqueue functions return straight away; irobPeriodic calls motionStep
+ *  once per tick, which starts the next motion when the last one is done.
+ *  Motions end on the distance or angle the Create reports (see
+ *  odometry.h), so the sensors read must include the distance and angle
+ *  packets. Each one slows down over its last stretch so the robot doesn't
+ *  coast past the target, and gives up after twice the time it should take
+ *  in case the sensors stop. Back-to-back motions run without stopping in
+ *  between; the robot stops once the queue runs dry.
+ *
+ *  The periodic function keeps running meanwhile, so it can check the
+ *  bumpers and cliff sensors and call motionAbort to preempt a motion.
+ */
+
+// Most motions that can be waiting at once
+#define MOTION_QUEUE_SIZE       (4)
+
+// Slowest speed used while slowing down in mm/s
+#define MOTION_MIN_VELOCITY     (50)
+// Distance (as a power of two) over which to slow down when moving in mm
+#define MOTION_DECEL_MM_SHIFT   (6)
+// Angle (as a power of two) over which to slow down when turning in degrees
+#define MOTION_DECEL_DEG_SHIFT  (4)
+
+//! Queue a straight move.
+/*!
+ *  \param velocity     The speed in mm/s. Negative backs up.
+ *  \param distance     The distance to travel in mm.
+ *  \return             0 if the queue was full, else 1.
+ */
+uint8_t motionEnqueueMove(int16_t velocity, uint16_t distance);
+
+//! Queue a turn on the spot.
+/*!
+ *  \param velocity     The wheel speed in mm/s.
+ *  \param radius       Either RadCW or RadCCW (see oi.h).
+ *  \param angle        The angle to rotate in degrees.
+ *  \return             0 if the queue was full, else 1.
+ */
+uint8_t motionEnqueueTurn(int16_t velocity, int16_t radius, uint16_t angle);
+
+//! Queue a drive along an arc.
+/*!
+ *  \param velocity     The speed in mm/s.
+ *  \param radius       The radius of the arc in mm. Positive turns
+ *                      counterclockwise, negative clockwise.
+ *  \param angle        The angle to drive around the arc in degrees.
+ *  \return             0 if the queue was full, else 1.
+ */
+uint8_t motionEnqueueArc(int16_t velocity, int16_t radius, uint16_t angle);
+
+//! Drop the current and queued motions, and stage a stop.
+void motionAbort(void);
+
+//! Advance the motion executor. irobPeriodic calls this every tick.
+/*!
+ *  Stages drive commands; the caller flushes them.
+ *
+ *  \return             1 while a motion is running, else 0.
+ */
+uint8_t motionStep(void);
+
+//! Check if a motion is running or waiting.
+uint8_t motionBusy(void);
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef ODOMETRY_H
+#define ODOMETRY_H
+
+#include <stdint.h>
+
+/*
+ *  Running totals of how far the Create has driven and turned, and a dead
+ *  reckoned pose built from them.
+ *
+ *  The Create's distance and angle packets report the change since they were
+ *  last sent, so every report has to be counted exactly once. The sensing
+ *  receive interrupt does that as each group or stream frame comes in, as
+ *  long as the group includes the distance and angle packets (19 and 20, or
+ *  a group packet holding them).
+ *
+ *  The pose integrates each report along the heading halfway through it, in
+ *  fixed point with a flash sine table, so an update costs a couple of
+ *  table reads and 16x16 multiplies (a few hundred cycles at most).
+ */
+
+// Fractional bits of the pose position
+#define ODOMETRY_Q_SHIFT    (8)
+
+// Where the robot is relative to where it was at the last reset
+typedef struct {
+    // Position in mm, with ODOMETRY_Q_SHIFT fractional bits. x is straight
+    // ahead of the starting heading, y to its left.
+    int32_t x;
+    int32_t y;
+    // Heading in degrees counterclockwise, 0-359
+    int16_t theta;
+} Pose;
+
+//! Add one distance/angle report to the totals.
+/*!
+ *  Called by the sensing receive interrupt; there's no need to call it.
+ *
+ *  \param distance_mm  Distance driven since the last report in mm.
+ *  \param angle_deg    Angle turned since the last report in degrees,
+ *                      counterclockwise positive.
+ */
+void odometryUpdate(int16_t distance_mm, int16_t angle_deg);
+
+//! Get the distance driven since the last reset in mm.
+int32_t odometryDistance(void);
+
+//! Get the angle turned since the last reset in degrees (CCW positive).
+int32_t odometryAngle(void);
+
+//! Get the dead reckoned pose.
+void odometryPose(Pose* pose);
+
+//! Zero the totals and the pose.
+void odometryReset(void);
+
+//! Get the sine of an angle.
+/*!
+ *  \param angle        The angle in degrees, any value.
+ *  \return             The sine in Q15 (32767 is 1).
+ */
+int16_t odometrySin(int16_t angle);
+
+//! Get the cosine of an angle.
+/*!
+ *  \param angle        The angle in degrees, any value.
+ *  \return             The cosine in Q15 (32767 is 1).
+ */
+int16_t odometryCos(int16_t angle);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+
+// # BINARY TELEMETRY #
+// Typed records instead of text, sent through the irobPut output (so they go
+// to byteTx, the software UART or the batched log, whatever setPutTxImpl
+// gave). A record is
+//     id, time_ms (low 16 bits of millis), fields..., CRC8
+// with every number little-endian, and the CRC (avr-libc's 8-bit CCITT,
+// polynomial 0x07) over everything before it. Each record goes out COBS
+// encoded and ends with a 0 byte, which appears nowhere else, so a reader can
+// pick up mid-stream and drop a corrupt record without losing the next one.
+// `ice telemetry capture.bin` turns a capture into CSV; its record table has
+// to match the ids and fields the project sends.
+
+// Largest record before encoding, id and time included, CRC excluded
+#ifndef TELEMETRY_MAX_SIZE
+#define TELEMETRY_MAX_SIZE  (32)
+#endif
+#if TELEMETRY_MAX_SIZE > 253
+#error "TELEMETRY_MAX_SIZE must fit one COBS block"
+#endif
+
+//! Start a record, stamped with the time now.
+/*!
+ *  \param id           Record type, 1-255.
+ */
+void telemetryBegin(uint8_t id);
+
+//! Add a field to the record started by telemetryBegin.
+/*!
+ *  Fields that don't fit in TELEMETRY_MAX_SIZE make telemetryEnd drop the
+ *  record.
+ */
+void telemetryU8(uint8_t value);
+void telemetryU16(uint16_t value);
+void telemetryI16(int16_t value);
+void telemetryU32(uint32_t value);
+
+//! Add the CRC, encode the record and send it.
+void telemetryEnd(void);
+
+//! Records dropped for being too big.
+uint16_t telemetryDropped(void);
+
+#endif
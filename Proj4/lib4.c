@@ -2,12 +2,27 @@
 #include "sensing.h"
 #include "driving.h"
 #include "oi.h"
-#include "fixedqueue.h"
+#include "pid.h"
 #include "irobserial.h"
 #include "irchar.h"
 #include "irobled.h"
-
-#define PID_DT  (IROB_PERIOD_MS)
+#include "sched.h"
+#include "motion.h"
+#include "irobscript.h"
+#ifdef LOG_OVER_SWUART
+#include "swuart.h"
+// A tick of text is up to 85 bytes
+#if !defined(LOG_BINARY) && SWUART_BUFFER_SIZE < 128
+#error "Text logging over the software UART needs SWUART_BUFFER_SIZE of 128"
+#endif
+#endif
+#ifdef LOG_BINARY
+#include "telemetry.h"
+#endif
+// The batched log should hold a few ticks, so it isn't drained every tick
+#if defined(LOG_OVER_USB) && !defined(LOG_BINARY) && LOG_BUFFER_SIZE < 256
+#error "Text logging over USB needs LOG_BUFFER_SIZE of 256"
+#endif
 
 #define PRED    (irPrevRegion() & IR_MASK_RED_BUOY)
 #define PGREEN  (irPrevRegion() & IR_MASK_GREEN_BUOY)
@@ -23,11 +38,11 @@
 //#define CHARGING    (getSensorInt16(SenCurr1) >= CURRENTTHOLD)
 #define CHARGING    (getSensorUint8(SenChAvailable))
 
-int16_t utk = 0;
-int16_t etk = 0;
-int16_t etk_1 = 0;
-int16_t esum = 0;
-FixedQueue esumQueue = 0;
+// Wall following controller; its output is the wheel speed difference.
+// The gains can be changed while running with pidSetGains.
+PidGains wallGains = { PID_KP, PID_KI, PID_KD, PID_D_SHIFT,
+    -PID_OUT_LIMIT, PID_OUT_LIMIT };
+Pid wallPid;
 
 uint8_t bumpDrop = 0;
 uint8_t prevBumpDrop = 0;
@@ -39,131 +54,230 @@ uint8_t dockingFinal = 0;
 uint8_t onDock = 0;
 
 int16_t jimmyAngle = 0;
+// The angle of the jimmy script the Create has (0 for none), and whether
+// it's playing
+int16_t jimmyLoadedAngle = 0;
+uint8_t jimmying = 0;
+
+// Whether dock steered last tick, and whether the region changed since
+uint8_t dockSteering = 0;
+uint8_t dockRegionChanged = 0;
+
+// The only sensors we use
+const uint8_t streamedPackets[] = {
+    PACKET_BUMPS_AND_WHEEL_DROPS,
+    PACKET_IR_CHAR,
+    PACKET_DISTANCE,
+    PACKET_ANGLE,
+    PACKET_WALL_SIGNAL,
+    PACKET_CHARGING_SOURCES
+};
+
+// Called by irobInit
+void lib4Init(void) {
+    sensorSetup();
+    wallPidSetup();
+    // Ramp the wheels instead of jumping between speeds
+    driveProfileSet(DRIVE_ACCEL, DRIVE_JERK);
+    // Build the leds up each tick, then send them once
+    irobledDefer(1);
+    // Docking reacts to IR region changes
+    setIrRegionChangeImpl(&dockRegionChange);
+#ifdef LOG_OVER_USB
+    // Collect the log in RAM and send it to USB in batches
+    logReset();
+#ifdef LOG_BINARY
+    setPutTxImpl(&logPutFrame);
+#else
+    setPutTxImpl(&logPut);
+#endif
+#endif
+#ifdef LOG_OVER_SWUART
+    // Log on the ePort so the Create link is never interrupted
+    swuartInit();
+#ifdef LOG_BINARY
+    setPutTxImpl(&swuartPutFrame);
+#else
+    setPutTxImpl(&swuartPut);
+#endif
+#endif
+    // Refresh the diagnostics LEDs in the background, even mid-turn
+    schedAdd(&dockingDiagnostics, DIAGNOSTICS_PERIOD_MS, 0,
+            DIAGNOSTICS_PERIOD_MS, 0);
+#ifdef LOG_ENABLED
+    // Report drops as they happen, not just at the end
+    schedAdd(&logStats, LOG_STATS_PERIOD_MS, LOG_STATS_PERIOD_MS,
+            LOG_STATS_PERIOD_MS, 0);
+#endif
+}
 
 /**
- * initilaization function for a pid controller.
+ * Has the Create stream the sensors we use, so they never have to be
+ * requested.
  */
-void pidSetup(void) {
-    while (esumQueue == 0) {
-        esumQueue = newFixedQueue(PID_QSIZE);
-    }
+void sensorSetup(void) {
+    sensingStreamStart(streamedPackets,
+            sizeof(streamedPackets) / sizeof(streamedPackets[0]));
 }
+
+#ifdef LOG_ENABLED
+// Print a label from flash and a number on one line
+void logI16(const char* label, int16_t value) {
+    irobPutStrP(label);
+    irobPutI16(value);
+    irobPutChar('\n');
+}
+#endif
+
+#ifdef LOG_ENABLED
+// Log what the log dropped, and how often batching had to switch to USB
+void logStats(void) {
+#ifdef LOG_OVER_SWUART
+    // The software UART never switches
+    uint16_t switches = 0;
+    uint16_t dropped = swuartDropped();
+#else
+    uint16_t switches = logSwitchesPerMinute();
+    uint16_t dropped = logDropped();
+#endif
+#ifdef LOG_BINARY
+    telemetryBegin(TEL_LOG_STATS);
+    telemetryU16(switches);
+    telemetryU16(dropped);
+    telemetryEnd();
+#else
+    logI16(PSTR("switches/min: "), switches);
+    logI16(PSTR("dropped: "), dropped);
+#endif
+}
+#endif
+
 /**
- * A function to clear the value of the esumQueue
- * which is used in the integral calculations for
- * the PID controller.
+ * initilaization function for the wall following pid controller.
  */
-void pidCleanup(void) {
-    if (esumQueue != 0) {
-        freeFixedQueue(esumQueue);
-        esumQueue = 0;
-    }
+void wallPidSetup(void) {
+    pidInit(&wallPid, &wallGains);
+}
+
+void lib4End(void) {
+#ifdef LOG_OVER_USB
+    // Send whatever is left before the Create powers off
+    logStats();
+    logDrain();
+#endif
+#ifdef LOG_OVER_SWUART
+    logStats();
+    swuartFlush();
+#endif
 }
 /**
- * Takes the next input for the pid controler
+ * Takes the next input for the wall following pid controller
  * utilizes constants:
  * PID_SET_POINT - the set point or goal
- * PID_KP - the multiplier for the current distance
- * PID_KI - the multiplier for the "integral" term
- * PID_KD - the multiplier for the "derivative" term
- * This then sets utk which is essentially the result
- * of this calculation
- * Important notes:
- * The derivative terms only look at this and the previous value
- * the integral term currently has no time mitigation and uses
- * a fixed size queue (now has damping based on size)
+ * The gains and limits are in wallGains (see utils/pid.h).
+ * The output, the wheel speed difference, is left in wallPid.output.
  * 
  * @param vtk the current value for the pid controller
  */
-void pidStep(uint16_t vtk) {
-    etk_1 = etk;
-    etk = ((int16_t)vtk) - PID_SET_POINT;
-    esum += etk;
-    esum -= pushPop(esumQueue, etk);
-    int16_t p = PID_KP*etk;
-    int16_t i = PID_KI*esum*PID_DT / PID_QSIZE; // damping
-    int16_t d = PID_KD*(etk-etk_1)/PID_DT;
-    irobprintf("etk_1: %d\netk: %d\nesum: %d\nutk: %d\np: %d\ni: %d\nd: %d\n",
-            etk_1, etk, esum, utk, p, i, d);
-    utk = p + i + d;
+void wallPidStep(uint16_t vtk) {
+    // The wall signal is at most 4095, so this can't overflow
+    int16_t etk = ((int16_t)vtk) - PID_SET_POINT;
+    pidStep(&wallPid, etk);
+#if defined(LOG_ENABLED) && defined(LOG_BINARY)
+    // The wall signal rides along
+    telemetryBegin(TEL_PID);
+    telemetryU16(vtk);
+    telemetryI16(etk);
+    telemetryI16(wallPid.output);
+    telemetryI16(wallPid.p);
+    telemetryI16(wallPid.i);
+    telemetryI16(wallPid.d);
+    telemetryEnd();
+#elif defined(LOG_ENABLED)
+    logI16(PSTR("etk: "), etk);
+    logI16(PSTR("utk: "), wallPid.output);
+    logI16(PSTR("p: "), wallPid.p);
+    logI16(PSTR("i: "), wallPid.i);
+    logI16(PSTR("d: "), wallPid.d);
+#endif
 }
 
 /**
- * A drive function which utilizes the utk value (modified in pidStep)
+ * A drive function which utilizes the wall pid output (set in wallPidStep)
  * this also utilizes 
- * DRIVE_DIVISOR - directly mitigates UTK
  * SPEED - the default speed
  */
 void updateMotors(void) {
-    int16_t deltaDrive = utk / DRIVE_DIVISOR;
+    int16_t deltaDrive = wallPid.output;
     driveDirect(SPEED - deltaDrive, SPEED + deltaDrive);
 }
 
-// Do while turning after bump
-void doWhileTurning(void) {
-    updateSensors();
-    uint8_t bumpDrop = getSensorUint8(SenBumpDrop);
-    if (bumpDrop & MASK_WHEEL_DROP) {
-        driveStop();
-    }
-    if (docking) {
-        updateIR();
-        dockingDiagnostics();
-    }
-}
-
 void move(int16_t distance) {
     int16_t speed = docking ? DOCKING_SPEED : SPEED;
-    driveDistanceTFunc(speed, distance, &doWhileTurning,
-            UPDATE_SENSOR_DELAY_PERIOD, UPDATE_SENSOR_DELAY_CUTOFF);
+    motionEnqueueMove(speed, distance);
 }
 void turn(int16_t radius, int16_t angle) {
     int16_t speed = docking ? DOCKING_SPEED : SPEED;
-    driveAngleTFunc(speed, radius, angle, &doWhileTurning,
-            UPDATE_SENSOR_DELAY_PERIOD, UPDATE_SENSOR_DELAY_CUTOFF);
+    motionEnqueueTurn(speed, radius, angle);
 }
 
-uint8_t noBump(void) {
-    return !(getSensorUint8(SenBumpDrop) & MASK_BUMP) && notCharging();
-}
-void jimmyBump(void) {
-    // Drive forward until bump
-    drivePredicateFunc(JIMMY_SPEED, RadStraight, &noBump,
-            &doWhileTurning, UPDATE_SENSOR_DELAY_PERIOD,
-            UPDATE_SENSOR_DELAY_CUTOFF);
-}
-uint8_t notCharging(void) {
-    return !CHARGING;
-}
-void jimmyTurn(int16_t radius) {
-    // Turn until charging
-    driveAnglePFunc(JIMMY_SPEED, radius, jimmyAngle, &notCharging,
-            &doWhileTurning, UPDATE_SENSOR_DELAY_PERIOD,
-            UPDATE_SENSOR_DELAY_CUTOFF);
-}
-void jimmy(void) {
-    // Increase angle every time
-    jimmyAngle += JIMMY_ANGLE;
+// The jimmy maneuver, as a Create script
+void jimmyScript(void) {
     // Turn right, then back to center
-    jimmyTurn(RadCW);
-    jimmyTurn(RadCCW);
-    // Bump the dock
-    jimmyBump();
+    irobscriptDrive(JIMMY_SPEED, RadCW);
+    irobscriptWaitAngle(-jimmyAngle);
+    irobscriptDrive(JIMMY_SPEED, RadCCW);
+    irobscriptWaitAngle(jimmyAngle);
+    // Push into the dock
+    irobscriptDrive(JIMMY_SPEED, RadStraight);
+    irobscriptWaitTime(JIMMY_PUSH_TENTHS);
     // Turn left, then back to center
-    jimmyTurn(RadCCW);
-    jimmyTurn(RadCW);
-    // Bump the dock
-    jimmyBump();
+    irobscriptDrive(JIMMY_SPEED, RadCCW);
+    irobscriptWaitAngle(jimmyAngle);
+    irobscriptDrive(JIMMY_SPEED, RadCW);
+    irobscriptWaitAngle(-jimmyAngle);
+    // Push into the dock
+    irobscriptDrive(JIMMY_SPEED, RadStraight);
+    irobscriptWaitTime(JIMMY_PUSH_TENTHS);
+    irobscriptDrive(0, RadStraight);
+}
+void jimmy(void) {
+    // Increase angle every time, up to a limit
+    if (jimmyAngle < JIMMY_MAX_ANGLE) {
+        jimmyAngle += JIMMY_ANGLE;
+    }
+    // The angle is baked into the script, so only upload a changed one
+    if (jimmyLoadedAngle != jimmyAngle) {
+        if (!irobscriptLoad(&jimmyScript)) {
+            return;
+        }
+        jimmyLoadedAngle = jimmyAngle;
+    }
+    // Let the Create wiggle onto the dock by itself. Don't wait here:
+    // iroblifePeriodic picks up once it's done.
+    irobscriptPlay();
+    jimmying = 1;
 }
 
-void dock(void) {
-    if (!dockingFinal && !PGREEN && GREEN) {
+// Called by updateIR when the IR region changes
+void dockRegionChange(uint8_t from, uint8_t to) {
+    if (!docking) {
+        return;
+    }
+    if (!dockingFinal && !(from & IR_MASK_GREEN_BUOY)
+            && (to & IR_MASK_GREEN_BUOY) && !motionBusy()
+            && !(bumpDrop & (MASK_WHEEL_DROP | MASK_BUMP))) {
         // Move an extra robot radius
         move(IROB_RAD_TURN);
         // Turn to line up
         turn(RadCW, FIELD_TURN);
         dockingFinal = 1;
-    } else if (dockingFinal && RED && !GREEN) {
+    }
+    dockRegionChanged = 1;
+}
+
+void dock(void) {
+    if (dockingFinal && RED && !GREEN) {
         // Course correction
         drive(DOCKING_SPEED, RadCCW);
     } else if (dockingFinal && !RED && GREEN) {
@@ -179,8 +293,8 @@ void dockingDiagnostics(void) {
     // Robot LEDs for IR fields
     robotLedSetBits(NEITHER_ROBOT_LED);
     powerLedSet(POWER_LED_ORANGE, 0);
-    if (smoothRed() > 0x60)     robotLedOn(PLAY_ROBOT_LED);
-    if (smoothGreen() > 0x60)   robotLedOn(ADVANCE_ROBOT_LED);
+    if (RED)    robotLedOn(PLAY_ROBOT_LED);
+    if (GREEN)  robotLedOn(ADVANCE_ROBOT_LED);
     if (irRegion() & IR_MASK_FORCE_FIELD) powerLedSet(POWER_LED_ORANGE, 0xFF);
     // Command module LEDs for charging.
     cmdLED1Set(0);
@@ -190,26 +304,51 @@ void dockingDiagnostics(void) {
     } else {
         cmdLED2Set(1);
     }
+    // One led command at most
+    irobledFlush();
 }
 
 // Called by irobPeriodic
 void iroblifePeriodic(void) {
+    // Whether dock steered last tick
+    uint8_t wasSteering = dockSteering;
+    dockSteering = 0;
     // Get bump & wheel drop sensor
     prevBumpDrop = bumpDrop;
     bumpDrop = getSensorUint8(SenBumpDrop);
     // IR
     updateIR();
-    dockingDiagnostics();
+    if (jimmying) {
+        // The stream, and so the ticks, come back when the script ends; the
+        // Create would ignore anything we sent before
+        if (irobscriptPlaying()) {
+            return;
+        }
+        jimmying = 0;
+        // The script left the robot stopped
+        driveHalt();
+    }
+    if (motionBusy()) {
+        // Let queued moves and turns finish unless we hit something
+        if (!(bumpDrop & (MASK_WHEEL_DROP | MASK_BUMP))) {
+            return;
+        }
+        motionAbort();
+    }
     if (onDock) {
         // Final connection on dock
         if (CHARGING) {
             driveStop();
+#ifdef LOG_OVER_USB
+            // Sitting on the dock is a good time to send the log
+            logDrain();
+#endif
         } else {
             jimmy();
         }
     } else if (bumpDrop & MASK_WHEEL_DROP) {
         // Cliff
-        driveStop();
+        driveHalt();
     } else if (bumpDrop & MASK_BUMP) {
         if (dockingFinal) {
             // We are now on the dock
@@ -223,7 +362,12 @@ void iroblifePeriodic(void) {
     } else if (prevBumpDrop & MASK_BUMP) {
         turn(RadCCW, OVERTURN);
     } else if (docking) {
-        dock();
+        // Only steer again when the region changed or we did something else
+        if (!wasSteering || dockRegionChanged) {
+            dock();
+        }
+        dockRegionChanged = 0;
+        dockSteering = 1;
     } else if (!docking && FIELD) {
         // Begin docking
         // If we were already in red, we're coming from front.
@@ -241,15 +385,18 @@ void iroblifePeriodic(void) {
         drive(SPEED, RadStraight);
     } else {
         // PID
-#ifdef LOG_OVER_USB
-        setSerialDestination(SERIAL_USB);
-#endif
         uint16_t wallSignal = getSensorUint16(SenWallSig1);
-        pidStep(wallSignal);
-#ifdef LOG_OVER_USB
-        irobprintf("wallSignal: %u\ndeltaDrive: %d\n\n", utk / DRIVE_DIVISOR);
-        setSerialDestination(SERIAL_CREATE);
+        wallPidStep(wallSignal);
+#if defined(LOG_ENABLED) && !defined(LOG_BINARY)
+        irobPutLit("wallSignal: ");
+        irobPutU16(wallSignal);
+        logI16(PSTR("\ndeltaDrive: "), wallPid.output);
+        irobPutChar('\n');
 #endif
         updateMotors();
+#ifdef LOG_OVER_USB
+        // Only switch to USB once a batch has built up
+        logService();
+#endif
     }
 }
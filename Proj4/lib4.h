@@ -3,16 +3,21 @@
 
 #include <stdint.h>
 
-// Delay constant
-#define IROB_PERIOD_MS  (32)
+// Loop period; one tick per streamed sensor frame
+#define IROB_PERIOD_MS  (15)
 
-// PID settings
+// PID settings. The gains are per tick, kp and kd Q8.8 and ki Q0.15 (see
+// utils/pid.h); the output is the wheel speed difference in mm/s, limited so
+// neither wheel reverses.
 #define PID_SET_POINT   (32)
-#define PID_KP          (256)
-#define PID_KI          (1)
-#define PID_KD          (64)
-#define DRIVE_DIVISOR   (128)
-#define PID_QSIZE       (128)
+#define PID_KP          (512)
+#define PID_KI          (30)
+#define PID_KD          (9)
+#define PID_D_SHIFT     (2)
+#define PID_OUT_LIMIT   (SPEED)
+
+// Docking diagnostics LED refresh period
+#define DIAGNOSTICS_PERIOD_MS   (100)
 
 // Charging current threshold
 #define CURRENTTHOLD    (-150)
@@ -22,36 +27,74 @@
 #define SPEED           (100)
 #define DOCKING_SPEED   (50)
 #define JIMMY_SPEED     (30)
+// Velocity profile limits in mm/s per tick (and per tick per tick)
+#define DRIVE_ACCEL     (8)
+#define DRIVE_JERK      (2)
 // Angle settings
 #define OVERTURN        (10)
 #define FIELD_TURN      (90)
 #define FRONT_TURN      (60)
 #define JIMMY_ANGLE     (10)
+// Each jimmy turns JIMMY_ANGLE further than the last, up to this. From then
+// on the script the Create already has is played again.
+#define JIMMY_MAX_ANGLE (40)
+// How long each jimmy leg pushes into the dock, in tenths of a second. A
+// timed push always ends, where waiting for a bump might never.
+#define JIMMY_PUSH_TENTHS   (20)
 // Distance settings
 #define FIELD_CLEARANCE (300)
 #define IROB_RAD_TURN   (150)
 
+// Log the wall following over USB (batched in RAM, switching the USART away
+// from the Create only when the batch fills or on the dock) or on the
+// software UART (PB3, no switching)
 //#define LOG_OVER_USB
+//#define LOG_OVER_SWUART
+#if defined(LOG_OVER_USB) || defined(LOG_OVER_SWUART)
+#define LOG_ENABLED
+#endif
+// Log as binary telemetry records instead of text, about a quarter of the
+// bytes. Decode a capture with `ice telemetry`. A tick of text is up to 85
+// bytes, so text logging needs bigger buffers in CDEFS: over USB
+// -DLOG_BUFFER_SIZE=256 (batches of 2 ticks), and over the software UART
+// -DSWUART_BUFFER_SIZE=128.
+#define LOG_BINARY
+
+// How often to log the log's own stats (what it dropped, and how often it
+// switched to USB) while running
+#define LOG_STATS_PERIOD_MS (1000)
+
+// Telemetry record ids. Keep in step with TELEMETRY_RECORDS in ice.
+#define TEL_PID         (1)
+#define TEL_LOG_STATS   (2)
 
-void pidSetup(void);
+//! Called by irobInit
+void lib4Init(void);
 
-void pidCleanup(void);
+void sensorSetup(void);
 
-void pidStep(uint16_t vtk);
+void wallPidSetup(void);
+
+
+//! Called by irobEnd
+void lib4End(void);
+
+void wallPidStep(uint16_t vtk);
+#ifdef LOG_ENABLED
+void logI16(const char* label, int16_t value);
+void logStats(void);
+#endif
 
 void updateMotors(void);
 
-void doWhileTurning(void);
 
 void move(int16_t distance);
 void turn(int16_t radius, int16_t angle);
 
-uint8_t noBump(void);
-void jimmyBump(void);
-uint8_t notCharging(void);
-void jimmyTurn(int16_t radius);
+void jimmyScript(void);
 void jimmy(void);
 
+void dockRegionChange(uint8_t from, uint8_t to);
 void dock(void);
 void dockingDiagnostics(void);
 
@@ -5,20 +5,17 @@
 
 int main(void) {
     // Submit to iroblife
-    setIrobInitImpl(&pidSetup);
+    setIrobInitImpl(&lib4Init);
     setIrobPeriodicImpl(&iroblifePeriodic);
-    setIrobEndImpl(&pidCleanup);
+    setIrobEndImpl(&lib4End);
 
     // Initialize the Create
     irobInit();
 
     // Infinite operation loop
     for(;;) {
-        // Periodic execution
-        irobPeriodic();
-       
-        // Delay for the loop; one second
-        delayAndUpdateSensors(IROB_PERIOD_MS);
+        // Periodic execution, once per streamed sensor frame
+        irobPeriodicSync();
     }
 }
 
@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "kinematics.h"
+
+// Compares the fixed-point kinematics with the formulas they replaced in
+// driving.c (32 bit math with PIe5 and divisions), over every speed.
+
+// Worst relative error allowed, for times over a second
+#define MAX_RELATIVE_ERROR  (0.002)
+// Worst absolute error allowed in ms
+#define MAX_ABSOLUTE_ERROR  (2)
+
+// The old driving.c formulas
+#define PIe5            314159
+#define TENTH_RADIUS    13
+
+uint32_t oldDistanceTimeMs(uint32_t distance, uint32_t velocity) {
+    return (1000 * distance) / velocity;
+}
+
+uint32_t oldAngleTimeMs(uint32_t angle, uint32_t velocity) {
+    return (PIe5 * TENTH_RADIUS * angle) / (1800 * velocity);
+}
+
+// Arc time in double precision, as there was no old formula for it
+uint32_t refArcTimeMs(uint32_t angle, uint32_t radius, uint32_t velocity) {
+    return 3.14159265 * radius * angle / 180 * 1000 / velocity;
+}
+
+// Wheel travel for a turn on the spot, in double precision
+uint32_t refArcMm(uint32_t angle) {
+    return 3.14159265 * KIN_HALF_WHEELBASE_MM * angle / 180 + 0.5;
+}
+
+double worstRelative = 0;
+long worstAbsolute = 0;
+
+// Track the worst error of one result
+void check(uint32_t got, uint32_t ref) {
+    long error = labs((long)got - (long)ref);
+    if (ref > 1000) {
+        double relative = (double)error / ref;
+        if (relative > worstRelative) {
+            worstRelative = relative;
+        }
+    } else if (error > worstAbsolute) {
+        worstAbsolute = error;
+    }
+}
+
+int main(void) {
+    uint32_t v, d, a, r;
+    // The geometry constants are worked out in 32 bits, as on the AVR
+    if (KIN_ARC_PER_DEG_Q != 581 || KIN_RAD_PER_DEG_Q16 != 1144) {
+        printf("kinematics: FAILED, constants %lu and %lu\n",
+                (unsigned long)KIN_ARC_PER_DEG_Q,
+                (unsigned long)KIN_RAD_PER_DEG_Q16);
+        return 1;
+    }
+    // Distance and speed conversions, within a mm (or mm/s)
+    for (a = 0; a <= 3600; a++) {
+        check(kinArcMm(a), refArcMm(a));
+        check(kinWheelSpeed(a), refArcMm(a));
+    }
+    for (v = 1; v <= 511; v++) {
+        for (d = 0; d <= 32767; d += d < 100 ? 1 : 37) {
+            check(kinDistanceTimeMs(d, v), oldDistanceTimeMs(d, v));
+        }
+        for (a = 0; a <= 720; a++) {
+            check(kinAngleTimeMs(a, v), oldAngleTimeMs(a, v));
+        }
+        for (r = 50; r <= 2000; r += 150) {
+            for (a = 0; a <= 360; a += 5) {
+                check(kinArcTimeMs(a, r, v), refArcTimeMs(a, r, v));
+            }
+        }
+    }
+    printf("kinematics: worst relative error %.5f, worst absolute %ld ms\n",
+            worstRelative, worstAbsolute);
+    if (worstRelative > MAX_RELATIVE_ERROR
+            || worstAbsolute > MAX_ABSOLUTE_ERROR) {
+        printf("kinematics: FAILED\n");
+        return 1;
+    }
+    return 0;
+}
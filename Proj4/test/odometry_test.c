@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "odometry.h"
+
+// Drives odometryUpdate with a long random path of small moves and turns
+// (like the Create's per-frame deltas) and compares the pose with the same
+// integration done in double precision.
+
+#define STEPS               (20000)
+// Worst position error allowed anywhere along the path, in mm
+#define MAX_POSITION_ERROR  (1.0)
+
+int main(void) {
+    double x = 0, y = 0, theta = 0;
+    double worst = 0;
+    Pose pose;
+    int i;
+    srand(1);
+    for (i = 0; i < STEPS; i++) {
+        int distance = rand() % 9 - 1;
+        int angle = rand() % 5 - 2;
+        if (i % 500 < 40) {
+            // Turn on the spot now and then
+            distance = 0;
+            angle = rand() % 7 + 1;
+        }
+        odometryUpdate(distance, angle);
+        // Reference: move along the heading halfway through the turn
+        double mid = (theta + angle / 2.0) * M_PI / 180;
+        x += distance * cos(mid);
+        y += distance * sin(mid);
+        theta += angle;
+        odometryPose(&pose);
+        double error = hypot(pose.x / (double)(1 << ODOMETRY_Q_SHIFT) - x,
+                pose.y / (double)(1 << ODOMETRY_Q_SHIFT) - y);
+        if (error > worst) {
+            worst = error;
+        }
+    }
+    double heading = fmod(theta, 360);
+    if (heading < 0) {
+        heading += 360;
+    }
+    printf("odometry: %ld mm path, worst error %.2f mm, heading %d (ref %.0f)\n",
+            (long)odometryDistance(), worst, pose.theta, heading);
+    if (worst > MAX_POSITION_ERROR || pose.theta != (int)heading) {
+        printf("odometry: FAILED\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,8 @@
+#ifndef TEST_INTERRUPT_H
+#define TEST_INTERRUPT_H
+
+// Host stand-in: there are no interrupts to hold off
+#define cli()
+#define sei()
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef TEST_IO_H
+#define TEST_IO_H
+
+#include <stdint.h>
+
+// Host stand-in: just the status register the atomic reads save
+static volatile uint8_t SREG;
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef TEST_PGMSPACE_H
+#define TEST_PGMSPACE_H
+
+#include <stdint.h>
+
+// Host stand-in: flash is ordinary memory
+#define PROGMEM
+#define PSTR(s)             (s)
+#define pgm_read_byte(p)    (*(const uint8_t*)(p))
+#define pgm_read_word(p)    (*(const uint16_t*)(p))
+
+#endif
@@ -2,6 +2,14 @@
 #include "oi.h"
 #include "timer.h"
 
+// Transmit ring buffer. byteTx writes at the head, the UDRE interrupt reads at
+// the tail.
+volatile uint8_t txBuffer[TX_BUFFER_SIZE];
+volatile uint8_t txHead = 0;
+volatile uint8_t txTail = 0;
+// Set when a byte has been handed to the USART but may not be out yet.
+volatile uint8_t txSent = 0;
+
 void initializeCommandModule(void){
     // Disable interrupts. ("Clear interrupt bit")
     cli();
@@ -28,7 +36,7 @@ void setupIOPins(void) {
 void setupSerialPort(void) {
     // Set the transmission speed to 57600 baud, which is what the Create expects,
     // unless we tell it otherwise.
-    UBRR0 = 19;
+    UBRR0 = Ubrr57600;
 
     // Enable both transmit and receive.
     UCSR0B = (_BV(RXCIE0) | _BV(TXEN0) | _BV(RXEN0));
@@ -43,13 +51,41 @@ void waitForEmptyTxBuffer(void) {
     while(!(UCSR0A & 0x20)) ;
 }
 
+// Move one byte from the ring buffer into the USART.
+static inline void txService(void) {
+    if (txHead != txTail) {
+        // Clear the transmit complete flag so txFlush can wait on it
+        UCSR0A |= _BV(TXC0);
+        UDR0 = txBuffer[txTail];
+        txTail = (txTail + 1) & TX_BUFFER_MASK;
+        txSent = 1;
+    }
+    if (txHead == txTail) {
+        // Nothing left to send; stop the interrupt
+        UCSR0B &= ~_BV(UDRIE0);
+    }
+}
+
+ISR(USART_UDRE_vect) {
+    // Interrupt handler called whenever the USART can take another byte.
+    txService();
+}
+
 void byteTx(uint8_t value) {
-    // Transmit one byte to the robot.
-    // Wait for the buffer to be empty.
-    waitForEmptyTxBuffer();
+    // Queue one byte for the robot.
+    uint8_t next = (txHead + 1) & TX_BUFFER_MASK;
+    // Wait for room in the buffer.
+    while (next == txTail) {
+        // With interrupts off, nobody else will empty the buffer
+        if (!(SREG & _BV(SREG_I)) && (UCSR0A & _BV(UDRE0))) {
+            txService();
+        }
+    }
 
-    // Send the byte.
-    UDR0 = value;
+    // Queue the byte and make sure the interrupt will send it.
+    txBuffer[txHead] = value;
+    txHead = next;
+    UCSR0B |= _BV(UDRIE0);
 }
 
 void uint16Tx(uint16_t value) {
@@ -58,6 +94,24 @@ void uint16Tx(uint16_t value) {
     byteTx((uint8_t)(value & 0x00FF));
 }
 
+void txFlush(void) {
+    // Wait for the ring buffer to drain.
+    while (txHead != txTail) {
+        if (!(SREG & _BV(SREG_I)) && (UCSR0A & _BV(UDRE0))) {
+            txService();
+        }
+    }
+    // Wait for the last byte to leave the shift register.
+    if (txSent) {
+        while (!(UCSR0A & _BV(TXC0))) ;
+        txSent = 0;
+    }
+}
+
+uint8_t txQueueDepth(void) {
+    return (txHead - txTail) & TX_BUFFER_MASK;
+}
+
 uint8_t byteRx(void) {
     // Receive one byte from the robot.
     // Call setupSerialPort() first.
@@ -73,10 +127,9 @@ void baud(uint8_t baud_code) {
   if(baud_code <= 11)
   {
     byteTx(CmdBaud);
-    UCSR0A |= _BV(TXC0);
     byteTx(baud_code);
     // Wait until transmit is complete
-    while(!(UCSR0A & _BV(TXC0))) ;
+    txFlush();
 
     cli();
 
@@ -5,6 +5,13 @@
 #include <avr/interrupt.h>
 #include <stdint.h>
 
+// Size of the transmit ring buffer. Must be a power of two.
+#define TX_BUFFER_SIZE  (64)
+#define TX_BUFFER_MASK  (TX_BUFFER_SIZE - 1)
+
+// Interrupts.
+ISR(USART_UDRE_vect);
+
 // Setup the I/O pins.
 void setupIOPins(void);
 
@@ -19,10 +26,18 @@ void initializeCommandModule(void);
 void waitForEmptyTxBuffer(void);
 
 // Send and receive data from the Command Module
+// byteTx and uint16Tx queue the bytes and return immediately unless the
+// transmit buffer is full. The USART data register empty interrupt sends them.
 void byteTx(uint8_t value);
 void uint16Tx(uint16_t value);
 uint8_t byteRx(void);
 
+// Wait for every queued byte to leave the USART.
+void txFlush(void);
+
+// Number of bytes waiting in the transmit buffer.
+uint8_t txQueueDepth(void);
+
 // Switch the baud rate on both Create and module  
 void baud(uint8_t baud_code);
 
@@ -1,16 +1,46 @@
 #include "irchar.h"
 #include "sensing.h"
 #include "oi.h"
+#include "timer.h"
 
-uint8_t _updateIR(uint8_t avg, uint8_t mask);
+// Which channels a region or IR byte has, as IR_MASK_ bits
+#define IR_CHANNELS         (IR_MASK_RED_BUOY | IR_MASK_GREEN_BUOY \
+                            | IR_MASK_FORCE_FIELD)
 
 uint8_t redRunningAverage = 0;
 uint8_t greenRunningAverage = 0;
 uint8_t fieldRunningAverage = 0;
 
+uint8_t irEnterThreshold = IR_ENTER_THRESHOLD;
+uint8_t irExitThreshold = IR_EXIT_THRESHOLD;
+
 uint8_t region = IR_NONE;
 uint8_t prevRegion = IR_NONE;
 
+#if IR_LOG_SIZE & (IR_LOG_SIZE - 1)
+#error "IR_LOG_SIZE must be a power of two"
+#endif
+#define IR_LOG_MASK         (IR_LOG_SIZE - 1)
+
+// Region transition log
+IrTransition irLog[IR_LOG_SIZE];
+uint8_t irLogHead = 0;
+uint8_t irLogLength = 0;
+uint16_t irLogDrops = 0;
+
+void irRegionChangeNull(uint8_t from, uint8_t to) {
+}
+
+void (*irRegionChangeImpl)(uint8_t from, uint8_t to) = &irRegionChangeNull;
+
+// Which channels an IR byte has, as IR_MASK_ bits
+uint8_t irChannels(uint8_t ir) {
+    if (ir == IR_NONE || (ir & IR_RESERVED) != IR_RESERVED) {
+        return 0;
+    }
+    return ir & IR_CHANNELS;
+}
+
 uint8_t irAny(void) {
     uint8_t ir = getSensorUint8(SenIRChar);
     if (ir == IR_NONE) return 0;
@@ -22,8 +52,7 @@ uint8_t irAll(void) {
 }
 
 uint8_t irCheck(uint8_t mask) {
-    if (!irAny())   return 0;
-    return (getSensorUint8(SenIRChar) & mask);
+    return irChannels(getSensorUint8(SenIRChar)) & mask;
 }
 
 uint8_t irRed(void) {
@@ -38,46 +67,73 @@ uint8_t irForceField(void) {
     return irCheck(IR_MASK_FORCE_FIELD);
 }
 
-uint8_t _updateIR(uint8_t avg, uint8_t mask) {
-    // Calculate running average
-    if (irCheck(mask)) {
-        avg = (((uint16_t)avg) * (SMOOTHING_INTENSITY - 1) + 0xFF)\
-              / SMOOTHING_INTENSITY;
-    } else {
-        avg /= SMOOTHING_INTENSITY;
+// Move a running average toward 0xFF if seen, else toward 0
+uint8_t irSmooth(uint8_t avg, uint8_t seen) {
+    if (seen) {
+        return avg + ((uint8_t)(0xFF - avg) >> IR_SMOOTHING_SHIFT);
+    }
+    return avg - (avg >> IR_DECAY_SHIFT);
+}
+
+// Whether a channel is in its field, given whether it was
+uint8_t irInField(uint8_t avg, uint8_t was) {
+    return avg > (was ? irExitThreshold : irEnterThreshold);
+}
+
+// Log the transition updateIR just saw
+void irLogTransition(void) {
+    IrTransition* transition;
+    if (irLogLength == IR_LOG_SIZE) {
+        // Full; drop the oldest
+        irLogHead = (irLogHead + 1) & IR_LOG_MASK;
+        irLogLength--;
+        irLogDrops++;
     }
-    return avg;
+    transition = &irLog[(irLogHead + irLogLength) & IR_LOG_MASK];
+    transition->time_ms = millis();
+    transition->from = prevRegion;
+    transition->to = region;
+    transition->red = redRunningAverage;
+    transition->green = greenRunningAverage;
+    transition->field = fieldRunningAverage;
+    irLogLength++;
 }
 
 void updateIR(void) {
-    // Calculate running averages
-    redRunningAverage = _updateIR(redRunningAverage, IR_MASK_RED_BUOY);
-    greenRunningAverage = _updateIR(greenRunningAverage, IR_MASK_GREEN_BUOY);
-    fieldRunningAverage = _updateIR(fieldRunningAverage, IR_MASK_FORCE_FIELD);
-    // Determine which (smoothed) region we're in
+    // Decode the byte once
+    uint8_t seen = irChannels(getSensorUint8(SenIRChar));
+    uint8_t was = region == IR_NONE ? 0 : region & IR_CHANNELS;
+    uint8_t in = 0;
+    redRunningAverage = irSmooth(redRunningAverage,
+            seen & IR_MASK_RED_BUOY);
+    greenRunningAverage = irSmooth(greenRunningAverage,
+            seen & IR_MASK_GREEN_BUOY);
+    fieldRunningAverage = irSmooth(fieldRunningAverage,
+            seen & IR_MASK_FORCE_FIELD);
+    // Which fields we're in, with hysteresis
+    if (irInField(redRunningAverage, was & IR_MASK_RED_BUOY)) {
+        in |= IR_MASK_RED_BUOY;
+    }
+    if (irInField(greenRunningAverage, was & IR_MASK_GREEN_BUOY)) {
+        in |= IR_MASK_GREEN_BUOY;
+    }
+    if (irInField(fieldRunningAverage, was & IR_MASK_FORCE_FIELD)) {
+        in |= IR_MASK_FORCE_FIELD;
+    }
+    // The region codes are just the channel bits over IR_RESERVED
     prevRegion = region;
-    uint8_t red = (smoothRed() > 0x60);
-    uint8_t green = (smoothGreen() > 0x60);
-    uint8_t field = (smoothForceField() > 0x60);
-    if (red && green && field) {
-        region = IR_ALL;
-    } else if (red && green) {
-        region = IR_RED_AND_GREEN;
-    } else if (red && field) {
-        region = IR_RED_AND_FIELD;
-    } else if (green && field) {
-        region = IR_GREEN_AND_FIELD;
-    } else if (red) {
-        region = IR_RED_BUOY;
-    } else if (green) {
-        region = IR_GREEN_BUOY;
-    } else if (field) {
-        region = IR_FORCE_FIELD;
-    } else {
-        region = IR_NOWHERE;
+    region = IR_RESERVED | in;
+    if (region != prevRegion) {
+        irLogTransition();
+        irRegionChangeImpl(prevRegion, region);
     }
 }
 
+void irSetThresholds(uint8_t enter, uint8_t exit) {
+    irEnterThreshold = enter;
+    irExitThreshold = exit;
+}
+
 uint8_t smoothRed(void) {
     return redRunningAverage;
 }
@@ -97,3 +153,25 @@ uint8_t irRegion(void) {
 uint8_t irPrevRegion(void) {
     return prevRegion;
 }
+
+void setIrRegionChangeImpl(void (*func)(uint8_t from, uint8_t to)) {
+    irRegionChangeImpl = func;
+}
+
+uint8_t irLogRead(IrTransition* transition) {
+    if (irLogLength == 0) {
+        return 0;
+    }
+    *transition = irLog[irLogHead];
+    irLogHead = (irLogHead + 1) & IR_LOG_MASK;
+    irLogLength--;
+    return 1;
+}
+
+uint8_t irLogCount(void) {
+    return irLogLength;
+}
+
+uint16_t irLogDropped(void) {
+    return irLogDrops;
+}
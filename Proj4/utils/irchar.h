@@ -3,8 +3,27 @@
 
 #include <stdint.h>
 
-// 1-0x101
-#define SMOOTHING_INTENSITY     (16)
+// Smoothing of the running averages: each update a channel is seen moves
+// them 1/2^shift of the way toward 0xFF
+#ifndef IR_SMOOTHING_SHIFT
+#define IR_SMOOTHING_SHIFT      (4)
+#endif
+// Same toward 0 for each update it isn't. Faster, so a field is left soon
+// after the signal goes: at the defaults a saturated average (240) falls to
+// the exit threshold in 2 updates, while a single missed update doesn't
+// leave it.
+#ifndef IR_DECAY_SHIFT
+#define IR_DECAY_SHIFT          (1)
+#endif
+
+// Running average a channel must rise above to enter its field, and fall to
+// (or below) to leave it again. See irSetThresholds.
+#ifndef IR_ENTER_THRESHOLD
+#define IR_ENTER_THRESHOLD      (0x60)
+#endif
+#ifndef IR_EXIT_THRESHOLD
+#define IR_EXIT_THRESHOLD       (0x40)
+#endif
 
 #define IR_RESERVED         (240)
 #define IR_NOWHERE          (IR_RESERVED)
@@ -21,6 +40,22 @@
 #define IR_MASK_GREEN_BUOY  (IR_GREEN_BUOY ^ IR_RESERVED)
 #define IR_MASK_FORCE_FIELD (IR_FORCE_FIELD ^ IR_RESERVED)
 
+// Region transitions kept for irLogRead (a power of two)
+#ifndef IR_LOG_SIZE
+#define IR_LOG_SIZE         (8)
+#endif
+
+// A change of region, as updateIR saw it
+typedef struct {
+    uint32_t time_ms;
+    uint8_t from;
+    uint8_t to;
+    // Running averages at the time
+    uint8_t red;
+    uint8_t green;
+    uint8_t field;
+} IrTransition;
+
 uint8_t irAny(void);
 uint8_t irAll(void);
 uint8_t irCheck(uint8_t mask);
@@ -28,7 +63,22 @@ uint8_t irRed(void);
 uint8_t irGreen(void);
 uint8_t irForceField(void);
 
+//! Smooth the latest IR byte and work out the region we're in.
+/*!
+ *  Decodes the IR byte once, moves the three running averages toward it,
+ *  and puts each channel in or out of its field with hysteresis between the
+ *  enter and exit thresholds. Call it once per sensor update.
+ */
 void updateIR(void);
+
+//! Set the running average thresholds for entering and leaving a field.
+/*!
+ *  \param enter        A channel enters its field above this.
+ *  \param exit         A channel leaves its field at or below this. Should
+ *                      be at most enter.
+ */
+void irSetThresholds(uint8_t enter, uint8_t exit);
+
 uint8_t smoothRed(void);
 uint8_t smoothGreen(void);
 uint8_t smoothForceField(void);
@@ -36,4 +86,26 @@ uint8_t smoothForceField(void);
 uint8_t irRegion(void);
 uint8_t irPrevRegion(void);
 
+//! Set the function updateIR calls when the region changes.
+/*!
+ *  Only called on transitions, with the old and new region.
+ */
+void setIrRegionChangeImpl(void (*func)(uint8_t from, uint8_t to));
+
+//! Take the oldest logged region transition.
+/*!
+ *  updateIR logs every transition. When the log is full the oldest one is
+ *  dropped, so draining it now and then is enough.
+ *
+ *  \param transition   Where to put it.
+ *  \return             0 if the log was empty, else 1.
+ */
+uint8_t irLogRead(IrTransition* transition);
+
+//! How many transitions are waiting in the log.
+uint8_t irLogCount(void);
+
+//! How many transitions were dropped because the log was full.
+uint16_t irLogDropped(void);
+
 #endif
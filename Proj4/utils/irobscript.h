@@ -0,0 +1,101 @@
+#ifndef IROBSCRIPT_H
+#define IROBSCRIPT_H
+
+#include <stdint.h>
+
+/*
+ *  Builds scripts for the Create's script engine (see CmdScript in oi.h).
+ *
+ *  A canned maneuver is uploaded once and then started with a single byte,
+ *  after which the Create runs it by itself: no drive commands or waits go
+ *  over the link, and the Command Module is free meanwhile.
+ *
+ *  Scripts are written as a build function that calls the irobscript
+ *  primitives. irobscriptLoad calls it twice, once to count the bytes and
+ *  once to send them, so no RAM is spent holding the script. The build
+ *  function must therefore send the same thing both times.
+ *
+ *  The Create ignores serial input while a script waits, so don't send it
+ *  anything until the script is done. If the Create is streaming sensors,
+ *  irobscriptPlay pauses the stream and the script's last command resumes
+ *  it; the first frame after that means the script is over (see
+ *  irobscriptPlaying).
+ */
+
+//! Upload a script, replacing the one the Create has.
+/*!
+ *  \param build        The function that calls the primitives below.
+ *  \return             0 if the script was too long (nothing was sent),
+ *                      else 1.
+ */
+uint8_t irobscriptLoad(void (*build)(void));
+
+//! Play the script last uploaded.
+/*!
+ *  The Create's drive and led state is forgotten (irobcmdInvalidate),
+ *  since the script changes it behind irobcmd's back.
+ */
+void irobscriptPlay(void);
+
+//! Whether the script last played is still running.
+/*!
+ *  Only known while streaming; otherwise always 0.
+ */
+uint8_t irobscriptPlaying(void);
+
+//! Wait for the script last played to finish.
+/*!
+ *  Sleeps meanwhile; nothing is sent to the Create and no sched.h tasks run.
+ *  The script should end by stopping the robot.
+ *
+ *  A timeout can't stop the robot: the script is still running and the
+ *  Create ignores serial input until it's done. Nothing is sent, and
+ *  irobscriptPlaying keeps saying so until the script resumes the stream.
+ *  Bound every leg of a script (WaitTime rather than WaitEvent for things
+ *  that might never happen) so it always ends by itself.
+ *
+ *  \param timeout_ms   The most to wait.
+ *  \return             1 if the script finished, 0 if it is still running.
+ */
+uint8_t irobscriptWaitMs(uint32_t timeout_ms);
+
+
+// # SCRIPT PRIMITIVES #
+// Only call these from a build function given to irobscriptLoad.
+
+//! Drive at a velocity along a radius (see drive in driving.h).
+void irobscriptDrive(int16_t velocity, int16_t radius);
+
+//! Drive the wheels directly (see driveDirect in driving.h).
+void irobscriptDriveDirect(int16_t left, int16_t right);
+
+//! Set the leds (see irobled.h).
+void irobscriptLeds(uint8_t bits, uint8_t color, uint8_t intensity);
+
+//! Wait for a time.
+/*!
+ *  \param tenths       The time in tenths of a second.
+ */
+void irobscriptWaitTime(uint8_t tenths);
+
+//! Wait until the robot has driven a distance.
+/*!
+ *  \param distance     The distance in mm; negative when backing up.
+ */
+void irobscriptWaitDistance(int16_t distance);
+
+//! Wait until the robot has turned an angle.
+/*!
+ *  \param angle        The angle in degrees; negative clockwise.
+ */
+void irobscriptWaitAngle(int16_t angle);
+
+//! Wait for an event.
+/*!
+ *  The script stops here until the event happens, however long that takes.
+ *  \param event        One of the Event codes (see oi.h); negate it to wait
+ *                      for the opposite.
+ */
+void irobscriptWaitEvent(int8_t event);
+
+#endif
@@ -0,0 +1,145 @@
+#include <stdint.h>
+#include "motion.h"
+#include "driving.h"
+#include "odometry.h"
+#include "kinematics.h"
+#include "timer.h"
+#include "oi.h"
+
+#define MOTION_MOVE     (0)
+#define MOTION_TURN     (1)
+
+typedef struct {
+    uint8_t type;
+    int16_t velocity;
+    int16_t radius;
+    // mm for moves, degrees for turns
+    uint16_t target;
+} Motion;
+
+// Waiting motions
+Motion motionQueue[MOTION_QUEUE_SIZE];
+uint8_t motionHead = 0;
+uint8_t motionCount = 0;
+
+// The running motion
+Motion motionCurrent;
+uint8_t motionActive = 0;
+int32_t motionStart = 0;
+uint32_t motionStart_ms = 0;
+uint32_t motionTimeout_ms = 0;
+
+uint8_t motionEnqueue(uint8_t type, int16_t velocity, int16_t radius,
+        uint16_t target) {
+    Motion* motion;
+    if (motionCount == MOTION_QUEUE_SIZE) {
+        return 0;
+    }
+    motion = &motionQueue[(motionHead + motionCount) % MOTION_QUEUE_SIZE];
+    motion->type = type;
+    motion->velocity = velocity;
+    motion->radius = radius;
+    motion->target = target;
+    motionCount++;
+    return 1;
+}
+
+uint8_t motionEnqueueMove(int16_t velocity, uint16_t distance) {
+    return motionEnqueue(MOTION_MOVE, velocity, RadStraight, distance);
+}
+
+uint8_t motionEnqueueTurn(int16_t velocity, int16_t radius, uint16_t angle) {
+    return motionEnqueue(MOTION_TURN, velocity, radius, angle);
+}
+
+uint8_t motionEnqueueArc(int16_t velocity, int16_t radius, uint16_t angle) {
+    return motionEnqueue(MOTION_TURN, velocity, radius, angle);
+}
+
+void motionAbort(void) {
+    motionCount = 0;
+    motionActive = 0;
+    driveStop();
+}
+
+uint8_t motionBusy(void) {
+    return motionActive || motionCount;
+}
+
+// Start the next waiting motion
+void motionStartNext(void) {
+    uint16_t speed;
+    motionCurrent = motionQueue[motionHead];
+    motionHead = (motionHead + 1) % MOTION_QUEUE_SIZE;
+    motionCount--;
+    speed = motionCurrent.velocity < 0
+        ? -motionCurrent.velocity : motionCurrent.velocity;
+    // Give up after twice the expected time
+    if (motionCurrent.type == MOTION_MOVE) {
+        motionStart = odometryDistance();
+        motionTimeout_ms = kinDistanceTimeMs(motionCurrent.target, speed);
+    } else {
+        motionStart = odometryAngle();
+        if (motionCurrent.radius == RadCW || motionCurrent.radius == RadCCW) {
+            motionTimeout_ms = kinAngleTimeMs(motionCurrent.target, speed);
+        } else {
+            motionTimeout_ms = kinArcTimeMs(motionCurrent.target,
+                    motionCurrent.radius < 0
+                    ? -motionCurrent.radius : motionCurrent.radius, speed);
+        }
+    }
+    motionTimeout_ms <<= 1;
+    motionStart_ms = millis();
+    motionActive = 1;
+    drive(motionCurrent.velocity, motionCurrent.radius);
+}
+
+uint8_t motionStep(void) {
+    int32_t done;
+    int32_t remaining;
+    uint8_t shift;
+    if (!motionActive) {
+        if (motionCount == 0) {
+            return 0;
+        }
+        motionStartNext();
+        return 1;
+    }
+    if (motionCurrent.type == MOTION_MOVE) {
+        done = odometryDistance() - motionStart;
+        if (motionCurrent.velocity < 0) {
+            done = -done;
+        }
+        shift = MOTION_DECEL_MM_SHIFT;
+    } else {
+        done = odometryAngle() - motionStart;
+        // Clockwise turns count down
+        if ((motionCurrent.velocity < 0) != (motionCurrent.radius < 0)) {
+            done = -done;
+        }
+        shift = MOTION_DECEL_DEG_SHIFT;
+    }
+    remaining = motionCurrent.target - done;
+    if (remaining <= 0 || millis() - motionStart_ms >= motionTimeout_ms) {
+        // Done; go straight on to the next one, or stop
+        motionActive = 0;
+        if (motionCount == 0) {
+            driveStop();
+            return 0;
+        }
+        motionStartNext();
+        return 1;
+    }
+    // Slow down linearly to MOTION_MIN_VELOCITY over the last stretch
+    if (remaining < (1 << shift)) {
+        int16_t speed = motionCurrent.velocity < 0
+            ? -motionCurrent.velocity : motionCurrent.velocity;
+        if (speed > MOTION_MIN_VELOCITY) {
+            speed = MOTION_MIN_VELOCITY
+                + (((speed - MOTION_MIN_VELOCITY) * remaining) >> shift);
+            drive(motionCurrent.velocity < 0 ? -speed : speed,
+                    motionCurrent.radius);
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,118 @@
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include "odometry.h"
+
+volatile int32_t odometryDistanceTotal = 0;
+volatile int32_t odometryAngleTotal = 0;
+volatile Pose odometryPoseNow = { 0, 0, 0 };
+
+// Half an ODOMETRY_Q_SHIFT step in Q15
+#define ODOMETRY_ROUND  (1L << (14 - ODOMETRY_Q_SHIFT))
+
+// sin of 0-90 degrees in Q15
+const int16_t sinTable[91] PROGMEM = {
+    0, 572, 1144, 1715, 2286, 2856, 3425, 3993, 4560, 5126,
+    5690, 6252, 6813, 7371, 7927, 8481, 9032, 9580, 10126, 10668,
+    11207, 11743, 12275, 12803, 13328, 13848, 14365, 14876, 15384, 15886,
+    16384, 16877, 17364, 17847, 18324, 18795, 19261, 19720, 20174, 20622,
+    21063, 21498, 21926, 22348, 22763, 23170, 23571, 23965, 24351, 24730,
+    25102, 25466, 25822, 26170, 26510, 26842, 27166, 27482, 27789, 28088,
+    28378, 28660, 28932, 29197, 29452, 29698, 29935, 30163, 30382, 30592,
+    30792, 30983, 31164, 31336, 31499, 31651, 31795, 31928, 32052, 32166,
+    32270, 32365, 32449, 32524, 32588, 32643, 32688, 32723, 32748, 32763,
+    32767
+};
+
+// Wrap an angle into 0-359. Subtracting beats a software division for the
+// small steps the pose takes.
+int16_t odometryWrap(int16_t angle) {
+    while (angle >= 360) {
+        angle -= 360;
+    }
+    while (angle < 0) {
+        angle += 360;
+    }
+    return angle;
+}
+
+int16_t odometrySin(int16_t angle) {
+    angle = odometryWrap(angle);
+    // Fold into the first quadrant
+    if (angle < 90) {
+        return pgm_read_word(&sinTable[angle]);
+    } else if (angle < 180) {
+        return pgm_read_word(&sinTable[180 - angle]);
+    } else if (angle < 270) {
+        return -pgm_read_word(&sinTable[angle - 180]);
+    }
+    return -pgm_read_word(&sinTable[360 - angle]);
+}
+
+int16_t odometryCos(int16_t angle) {
+    return odometrySin(angle + 90);
+}
+
+void odometryUpdate(int16_t distance_mm, int16_t angle_deg) {
+    int16_t heading;
+    int16_t c;
+    int16_t sn;
+    odometryDistanceTotal += distance_mm;
+    odometryAngleTotal += angle_deg;
+    if (distance_mm) {
+        // Move along the heading halfway through the turn. An odd turn puts
+        // that between two table entries, so average them.
+        heading = odometryPoseNow.theta + (angle_deg >> 1);
+        c = odometryCos(heading);
+        sn = odometrySin(heading);
+        if (angle_deg & 1) {
+            c = ((int32_t)c + odometryCos(heading + 1)) >> 1;
+            sn = ((int32_t)sn + odometrySin(heading + 1)) >> 1;
+        }
+        // Q15 products, rounded to nearest at ODOMETRY_Q_SHIFT so the error
+        // doesn't build up one way
+        odometryPoseNow.x += ((int32_t)distance_mm * c + ODOMETRY_ROUND)
+            >> (15 - ODOMETRY_Q_SHIFT);
+        odometryPoseNow.y += ((int32_t)distance_mm * sn + ODOMETRY_ROUND)
+            >> (15 - ODOMETRY_Q_SHIFT);
+    }
+    odometryPoseNow.theta = odometryWrap(odometryPoseNow.theta + angle_deg);
+}
+
+int32_t odometryDistance(void) {
+    // Don't let the receive interrupt update it halfway through the read
+    uint8_t sreg = SREG;
+    cli();
+    int32_t distance = odometryDistanceTotal;
+    SREG = sreg;
+    return distance;
+}
+
+int32_t odometryAngle(void) {
+    uint8_t sreg = SREG;
+    cli();
+    int32_t angle = odometryAngleTotal;
+    SREG = sreg;
+    return angle;
+}
+
+void odometryPose(Pose* pose) {
+    uint8_t sreg = SREG;
+    cli();
+    pose->x = odometryPoseNow.x;
+    pose->y = odometryPoseNow.y;
+    pose->theta = odometryPoseNow.theta;
+    SREG = sreg;
+}
+
+void odometryReset(void) {
+    uint8_t sreg = SREG;
+    cli();
+    odometryDistanceTotal = 0;
+    odometryAngleTotal = 0;
+    odometryPoseNow.x = 0;
+    odometryPoseNow.y = 0;
+    odometryPoseNow.theta = 0;
+    SREG = sreg;
+}
@@ -25,10 +25,17 @@
 #define CmdPWMMotors    144
 #define CmdDriveWheels  145
 #define CmdOutputs      147
+#define CmdStream       148
 #define CmdSensorList   149
+#define CmdPauseStream  150
 #define CmdIRChar       151
+#define CmdScript       152
+#define CmdPlayScript   153
+#define CmdShowScript   154
+#define WaitForTime     155
 #define WaitForDistance 156
 #define WaitForAngle    157
+#define WaitForEvent    158
 
 
 // Sensor byte indices - offsets in packets 0, 5 and 6
@@ -93,6 +100,12 @@
 #define Sen5Size        12
 #define Sen6Size        52
 
+// Stream packets
+#define StreamHeader    19
+#define StreamPeriodMs  15
+#define StreamPause     0
+#define StreamResume    1
+
 // Sensor bit masks
 #define WheelDropFront  0x10
 #define WheelDropLeft   0x08
@@ -111,6 +124,33 @@
 #define LEDPlay         0x02
 #define LEDsBoth        0x0A
 
+// Wait for event codes (negate to wait for the opposite)
+#define EventWheelDrop      1
+#define EventFrontWheelDrop 2
+#define EventLeftWheelDrop  3
+#define EventRightWheelDrop 4
+#define EventBump           5
+#define EventLeftBump       6
+#define EventRightBump      7
+#define EventVirtualWall    8
+#define EventWall           9
+#define EventCliff          10
+#define EventLeftCliff      11
+#define EventFrontLeftCliff 12
+#define EventFrontRightCliff 13
+#define EventRightCliff     14
+#define EventHomeBase       15
+#define EventAdvanceButton  16
+#define EventPlayButton     17
+#define EventDigitalInput0  18
+#define EventDigitalInput1  19
+#define EventDigitalInput2  20
+#define EventDigitalInput3  21
+#define EventOIPassive      22
+
+// Longest script the Create holds in bytes
+#define ScriptMaxSize   100
+
 // OI Modes
 #define OIPassive       1
 #define OISafe          2
@@ -139,19 +179,34 @@
 
 
 
-// Baud UBRRx values
-#define Ubrr300         3839
-#define Ubrr600         1919
-#define Ubrr1200        959
-#define Ubrr2400        479
-#define Ubrr4800        239
-#define Ubrr9600        119
-#define Ubrr14400       79
-#define Ubrr19200       59
-#define Ubrr28800       39
-#define Ubrr38400       29
-#define Ubrr57600       19
-#define Ubrr115200      9
+// Baud UBRRx values, worked out from F_CPU (normal speed: 16 clocks a bit)
+#ifndef F_CPU
+#error "F_CPU must be defined (see CDEFS in the Makefile)"
+#endif
+#define UbrrFor(baud)   ((F_CPU + 8UL * (baud)) / (16UL * (baud)) - 1)
+// Actual baud rate error for a UBRR value, in tenths of a percent
+#define UbrrErrorPermille(baud) \
+    ((F_CPU / (16UL * (UbrrFor(baud) + 1)) > (baud) \
+        ? F_CPU / (16UL * (UbrrFor(baud) + 1)) - (baud) \
+        : (baud) - F_CPU / (16UL * (UbrrFor(baud) + 1))) * 1000 / (baud))
+
+#define Ubrr300         UbrrFor(300)
+#define Ubrr600         UbrrFor(600)
+#define Ubrr1200        UbrrFor(1200)
+#define Ubrr2400        UbrrFor(2400)
+#define Ubrr4800        UbrrFor(4800)
+#define Ubrr9600        UbrrFor(9600)
+#define Ubrr14400       UbrrFor(14400)
+#define Ubrr19200       UbrrFor(19200)
+#define Ubrr28800       UbrrFor(28800)
+#define Ubrr38400       UbrrFor(38400)
+#define Ubrr57600       UbrrFor(57600)
+#define Ubrr115200      UbrrFor(115200)
+
+// The rates we talk to the Create at must be within the USART's tolerance
+#if UbrrErrorPermille(57600) > 20 || UbrrErrorPermille(115200) > 20
+#error "F_CPU can't make 57600/115200 baud within 2%"
+#endif
 
 
 // Command Module button and LEDs
@@ -0,0 +1,108 @@
+#include <stdint.h>
+#include "pid.h"
+
+// Clamp a 32 bit value to 16 bits
+int16_t pidSat16(int32_t value) {
+    if (value > INT16_MAX) {
+        return INT16_MAX;
+    } else if (value < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return value;
+}
+
+// Add without wrapping around
+int32_t pidSatAdd32(int32_t a, int32_t b) {
+    int32_t sum = (int32_t)((uint32_t)a + (uint32_t)b);
+    // Overflow when both have the same sign and the sum doesn't
+    if (((a ^ sum) & (b ^ sum)) < 0) {
+        return a < 0 ? INT32_MIN : INT32_MAX;
+    }
+    return sum;
+}
+
+void pidInit(Pid* pid, const PidGains* gains) {
+    pid->gains = *gains;
+    pidReset(pid);
+}
+
+void pidSetGains(Pid* pid, const PidGains* gains) {
+    pid->gains = *gains;
+    // New limits apply to the integral term at once
+    int32_t max = (int32_t)gains->outMax << 16;
+    int32_t min = (int32_t)gains->outMin << 16;
+    if (pid->integral > max) {
+        pid->integral = max;
+    } else if (pid->integral < min) {
+        pid->integral = min;
+    }
+}
+
+void pidReset(Pid* pid) {
+    pid->integral = 0;
+    pid->derivative = 0;
+    pid->prevError = 0;
+    pid->primed = 0;
+    pid->saturated = 0;
+    pid->p = 0;
+    pid->i = 0;
+    pid->d = 0;
+    pid->output = 0;
+}
+
+int16_t pidStep(Pid* pid, int16_t error) {
+    const PidGains* g = &pid->gains;
+
+    // P: 16x16 product, Q8.8 back to whole units. Can't overflow 32 bits.
+    int32_t p = ((int32_t)g->kp * error) >> 8;
+
+    // I: add ki * error (Q15, so twice for Q16) unless the output is
+    // pinned and this would pin it harder
+    int32_t step = (int32_t)g->ki * error;
+    if (!(pid->saturated > 0 && step > 0)
+            && !(pid->saturated < 0 && step < 0)) {
+        int32_t integral = pidSatAdd32(pidSatAdd32(pid->integral, step), step);
+        int32_t max = (int32_t)g->outMax << 16;
+        int32_t min = (int32_t)g->outMin << 16;
+        if (integral > max) {
+            integral = max;
+        } else if (integral < min) {
+            integral = min;
+        }
+        pid->integral = integral;
+    }
+    int16_t i = pid->integral >> 16;
+
+    // D: difference of the error (none on the first step), through a
+    // one-pole low-pass in Q8.8
+    int16_t diff = 0;
+    if (pid->primed) {
+        diff = pidSat16((int32_t)error - pid->prevError);
+    }
+    pid->prevError = error;
+    pid->primed = 1;
+    pid->derivative += (((int32_t)diff << 8) - pid->derivative) >> g->dShift;
+    // kd * derivative is Q16.16 and may not fit 32 bits; split the Q8.8
+    // value into whole and fraction parts and multiply each
+    int32_t whole = (pid->derivative >> 8) * (int32_t)g->kd;
+    int32_t fraction = ((pid->derivative & 0xFF) * (int32_t)g->kd) >> 8;
+    int32_t d = (whole + fraction) >> 8;
+
+    // Each term fits 24 bits, so the sum can't overflow
+    int32_t u = p + i + d;
+    if (u > g->outMax) {
+        u = g->outMax;
+        pid->saturated = 1;
+    } else if (u < g->outMin) {
+        u = g->outMin;
+        pid->saturated = -1;
+    } else {
+        pid->saturated = 0;
+    }
+
+    pid->p = pidSat16(p);
+    pid->i = i;
+    pid->d = pidSat16(d);
+    pid->output = u;
+    return u;
+}
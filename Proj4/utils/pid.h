@@ -0,0 +1,69 @@
+#ifndef PID_H
+#define PID_H
+
+#include <stdint.h>
+
+// # PID CONTROLLER #
+// Fixed-point PID with saturating arithmetic, for loops run once a tick. The
+// proportional and derivative gains are Q8.8 and the integral gain is Q0.15,
+// since useful integral gains per tick are well under 1. The integrator
+// keeps the integral term itself in Q16.16, so changing ki doesn't make the
+// output jump, and it's clamped to the output limits. It only integrates
+// while that doesn't push an output already at a limit further past it
+// (conditional integration), so it can't wind up. The derivative is of the
+// error, low-pass filtered.
+
+//! Gains and limits. Can be changed while running with pidSetGains.
+typedef struct {
+    //! Proportional gain, Q8.8 (256 is 1).
+    int16_t kp;
+    //! Integral gain per tick, Q0.15 (32768 would be 1).
+    int16_t ki;
+    //! Derivative gain per tick, Q8.8.
+    int16_t kd;
+    //! Derivative filter: each tick it moves 1/2^dShift of the way to the
+    //! new difference. 0 is unfiltered.
+    uint8_t dShift;
+    //! Output limits, outMin < outMax.
+    int16_t outMin;
+    int16_t outMax;
+} PidGains;
+
+//! Controller state. Set it up with pidInit.
+typedef struct {
+    PidGains gains;
+    //! Integral term, Q16.16.
+    int32_t integral;
+    //! Filtered difference of the error, Q8.8.
+    int32_t derivative;
+    int16_t prevError;
+    //! prevError is valid.
+    uint8_t primed;
+    //! The last output was clamped: 1 high, -1 low, 0 not.
+    int8_t saturated;
+    //! The terms and output of the last step, for logging.
+    int16_t p;
+    int16_t i;
+    int16_t d;
+    int16_t output;
+} Pid;
+
+//! Set the gains and start from rest.
+void pidInit(Pid* pid, const PidGains* gains);
+
+//! Change the gains, keeping the integral term.
+void pidSetGains(Pid* pid, const PidGains* gains);
+
+//! Forget the integral and derivative history.
+void pidReset(Pid* pid);
+
+//! Run one tick.
+/*!
+ *  \param pid          The controller.
+ *  \param error        Set point minus measurement (or the other way, to
+ *                      flip the output).
+ *  \return             The output, within the limits.
+ */
+int16_t pidStep(Pid* pid, int16_t error);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+
+/*
+ *  A small run-to-completion scheduler driven off the 1 ms timer.
+ *
+ *  Register periodic tasks with schedAdd, then keep calling schedStep (or
+ *  one of the schedRun functions) from your loop. Each due task runs to
+ *  completion, in the order they were added. The schedRun functions sleep
+ *  (timerIdle) whenever nothing was due. The delay*Func functions in
+ *  timer.h run on top of this, so registered tasks keep running while the
+ *  robot is inside a blocking move.
+ */
+
+// Most tasks that can be registered at once
+#define SCHED_MAX_TASKS     (8)
+
+// Returned by schedAdd when there is no room
+#define SCHED_NO_TASK       (0xFF)
+
+// Pass to schedStep when there is no end in sight
+#define SCHED_NO_CUTOFF     (0xFFFF)
+
+//! Register a periodic task.
+/*!
+ *  \param func         The function to run.
+ *  \param period_ms    How often to run it. 0 runs it on every step.
+ *  \param phase_ms     How long from now until it first runs.
+ *  \param deadline_ms  How late it may start before it counts as an overrun.
+ *  \param cutoff_ms    Don't start it when a schedRun is this close to its
+ *                      end.
+ *  \return             The task's ID, or SCHED_NO_TASK if there was no room.
+ */
+uint8_t schedAdd(void (*func)(void), uint16_t period_ms, uint16_t phase_ms,
+        uint16_t deadline_ms, uint16_t cutoff_ms);
+
+//! Unregister a task.
+void schedRemove(uint8_t task);
+
+//! How many times a task started past its deadline (missed periods count).
+uint16_t schedOverruns(uint8_t task);
+
+//! Run every task that is due once.
+/*!
+ *  \param remaining_ms How long until the caller has to be done; tasks whose
+ *                      cutoff is at least this are skipped.
+ *  \return             1 if any task ran.
+ */
+uint8_t schedStep(uint16_t remaining_ms);
+
+//! Run tasks for some milliseconds.
+void schedRunMs(uint32_t time_ms);
+
+//! Run tasks while a predicate holds.
+void schedRunPredicate(uint8_t (*pred)(void));
+
+//! Run tasks for some milliseconds, or until a predicate fails.
+void schedRunMsPredicate(uint32_t time_ms, uint8_t (*pred)(void));
+
+#endif
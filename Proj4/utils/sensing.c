@@ -1,14 +1,236 @@
 #include <stdint.h>
+#include <avr/pgmspace.h>
 #include "sensing.h"
 #include "cmod.h"
 #include "timer.h"
 #include "oi.h"
 #include "irobserial.h"
+#include "odometry.h"
+
+// A set of packets requested (or streamed) together
+typedef struct {
+    const uint8_t* packetIds;
+    uint8_t count;
+    // Where the group's data starts in the sensor buffer, and how long it is
+    uint8_t base;
+    uint8_t size;
+    // Polling rate
+    uint16_t period_ms;
+    uint16_t lastPoll_ms;
+} SensorGroup;
+
+SensorGroup sensorGroups[SENSOR_MAX_GROUPS];
+uint8_t sensorGroupCount = 0;
+// Bytes of the sensor buffer taken by the groups
+uint8_t sensorBufferUsed = 0;
+
+// Where each single packet's data starts in the sensor buffer, plus one
+// (0 means no group selected it)
+#define NO_SLOT (0xFF)
+uint8_t packetSlots[PACKET_MAX - PACKET_MIN_SINGLE + 1];
+
+#if SENSOR_BUFFER_SIZE >= Sen6Size
+// The group polled when none are declared, and whether it's the one there.
+// The first group declared replaces it.
+const uint8_t allPackets[] = { PACKET_ALL };
+uint8_t sensorFallback = 0;
+#endif
 
 volatile uint8_t usartActive = 0;
 volatile uint8_t sensorIndex = 0;
-volatile uint8_t sensorBuffer[Sen6Size];
-volatile uint8_t sensors[Sen6Size];
+volatile uint8_t sensorEnd = 0;
+// The group last requested
+volatile uint8_t activeGroup = 0;
+// Some of the polled group's bytes were replayed from the last snapshot
+volatile uint8_t groupReplayed = 0;
+
+// Sensor snapshots. The receive interrupt fills the write snapshot and swaps
+// it with the latest one when it is complete; the main loop swaps the latest
+// one with the one it reads. A third snapshot means the interrupt never
+// writes the one being read.
+SensorSnapshot snapshots[3];
+volatile uint8_t latestSnapshot = 0;
+volatile uint8_t freshSnapshot = 0;
+volatile uint8_t writeSnapshot = 1;
+uint8_t readSnapshot = 2;
+volatile uint16_t snapshotSequence = 0;
+
+// Where each packet's data lives in the packet 6 layout, by packet ID
+const uint8_t packetOffsets[PACKET_MAX + 1] PROGMEM = {
+    // Group packets 0-6
+    SenBumpDrop, SenBumpDrop, SenIRChar, SenChargeState, SenWallSig1,
+    SenOIMode, SenBumpDrop,
+    // Single packets 7-42
+    SenBumpDrop, SenWall, SenCliffL, SenCliffFL, SenCliffFR, SenCliffR,
+    SenVWall, SenOverC, 8, 9, SenIRChar, SenButton, SenDist1, SenAng1,
+    SenChargeState, SenVolt1, SenCurr1, SenTemp, SenCharge1, SenCap1,
+    SenWallSig1, SenCliffLSig1, SenCliffFLSig1, SenCliffFRSig1, SenCliffRSig1,
+    SenInputs, SenAInput1, SenChAvailable, SenOIMode, SenOISong,
+    SenOISongPlay, SenStreamPckts, SenVel1, SenRad1, SenVelR1, SenVelL1
+};
+
+// How many bytes of data each packet has, by packet ID
+const uint8_t packetSizes[PACKET_MAX + 1] PROGMEM = {
+    // Group packets 0-6
+    Sen0Size, Sen1Size, Sen2Size, Sen3Size, Sen4Size, Sen5Size, Sen6Size,
+    // Single packets 7-42
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 1, 2, 2, 1, 2, 2, 2, 2, 2, 2, 2,
+    1, 2, 1, 1, 1, 1, 1, 2, 2, 2, 2
+};
+
+// Which single packet each packet 6 index belongs to
+const uint8_t indexPackets[Sen6Size] PROGMEM = {
+    7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19,
+    19, 20, 20, 21, 22, 22, 23, 23, 24, 25, 25, 26, 26,
+    27, 27, 28, 28, 29, 29, 30, 30, 31, 31, 32, 33, 33,
+    34, 35, 36, 37, 38, 39, 39, 40, 40, 41, 41, 42, 42
+};
+
+// Stream frame parser states
+#define STREAM_HEADER   (0)
+#define STREAM_LENGTH   (1)
+#define STREAM_ID       (2)
+#define STREAM_DATA     (3)
+#define STREAM_CHECKSUM (4)
+
+volatile uint8_t streaming = 0;
+
+// Stream frame parser
+volatile uint8_t streamState = STREAM_HEADER;
+volatile uint8_t streamRemaining = 0;
+volatile uint8_t streamPacketLeft = 0;
+volatile uint8_t streamOffset = 0;
+volatile uint8_t streamChecksum = 0;
+
+// Find a packet 6 index in the sensor buffer. Returns NO_SLOT if no group
+// selected it.
+uint8_t sensorPosition(uint8_t index) {
+    uint8_t id = pgm_read_byte(&indexPackets[index]);
+    uint8_t slot = packetSlots[id - PACKET_MIN_SINGLE];
+    if (slot == 0) {
+        return NO_SLOT;
+    }
+    return slot - 1 + index - pgm_read_byte(&packetOffsets[id]);
+}
+
+// Make room for a packet's data at the end of the sensor buffer
+uint8_t layoutPacket(uint8_t id) {
+    uint8_t offset = pgm_read_byte(&packetOffsets[id]);
+    uint8_t size = pgm_read_byte(&packetSizes[id]);
+    uint8_t i;
+    if (sensorBufferUsed + size > SENSOR_BUFFER_SIZE) {
+        return 0;
+    }
+    // Point every single packet this one contains at its new room
+    for (i = offset; i < offset + size; i++) {
+        uint8_t single = pgm_read_byte(&indexPackets[i]);
+        if (pgm_read_byte(&packetOffsets[single]) == i) {
+            packetSlots[single - PACKET_MIN_SINGLE] =
+                sensorBufferUsed + i - offset + 1;
+        }
+    }
+    sensorBufferUsed += size;
+    return 1;
+}
+
+// The most recently published snapshot. Once sensorSnapshot has taken the
+// latest one it's the read snapshot, and latestSnapshot holds older data.
+// Only called with interrupts off.
+const SensorSnapshot* newestSnapshot(void) {
+    return &snapshots[freshSnapshot ? latestSnapshot : readSnapshot];
+}
+
+// Finish the write snapshot once a group has come in, and make it the latest.
+// Only called from the receive interrupt.
+void publishGroup(uint8_t group) {
+    uint8_t i;
+    uint8_t base = sensorGroups[group].base;
+    uint8_t end = base + sensorGroups[group].size;
+    SensorSnapshot* write = &snapshots[writeSnapshot];
+    const SensorSnapshot* newest = newestSnapshot();
+    // The other groups' data is whatever came in last
+    for (i = 0; i < base; i++) {
+        write->data[i] = newest->data[i];
+    }
+    for (i = end; i < sensorBufferUsed; i++) {
+        write->data[i] = newest->data[i];
+    }
+    // Distance and angle are deltas, so count them as they come in
+    uint8_t dist = sensorPosition(SenDist1);
+    uint8_t ang = sensorPosition(SenAng1);
+    int16_t distance = 0;
+    int16_t angle = 0;
+    if (dist != NO_SLOT && dist >= base && dist < end) {
+        distance = (int16_t)sensorSnapshotUint16(write, SenDist1);
+    }
+    if (ang != NO_SLOT && ang >= base && ang < end) {
+        angle = (int16_t)sensorSnapshotUint16(write, SenAng1);
+    }
+    // Replayed deltas were already counted
+    if ((distance || angle) && !groupReplayed) {
+        odometryUpdate(distance, angle);
+    }
+    groupReplayed = 0;
+    write->sequence = ++snapshotSequence;
+    write->time_ms = millis();
+    // Swap it in
+    uint8_t tmp = latestSnapshot;
+    latestSnapshot = writeSnapshot;
+    writeSnapshot = tmp;
+    freshSnapshot = 1;
+}
+
+// Feed one byte of a stream frame to the parser
+void streamParse(uint8_t b) {
+    streamChecksum += b;
+    switch (streamState) {
+    case STREAM_HEADER:
+        // Wait for the start of a frame
+        if (b == StreamHeader) {
+            streamChecksum = b;
+            streamState = STREAM_LENGTH;
+        }
+        break;
+    case STREAM_LENGTH:
+        streamRemaining = b;
+        streamState = b ? STREAM_ID : STREAM_CHECKSUM;
+        break;
+    case STREAM_ID:
+        if (b > PACKET_MAX) {
+            // Not a packet we know; we must have lost sync
+            streamState = STREAM_HEADER;
+            break;
+        }
+        streamOffset = sensorPosition(pgm_read_byte(&packetOffsets[b]));
+        streamPacketLeft = pgm_read_byte(&packetSizes[b]);
+        if (streamOffset == NO_SLOT
+                || streamOffset + streamPacketLeft > SENSOR_BUFFER_SIZE) {
+            // Not a packet we asked for
+            streamState = STREAM_HEADER;
+            break;
+        }
+        streamRemaining--;
+        streamState = streamRemaining ? STREAM_DATA : STREAM_CHECKSUM;
+        break;
+    case STREAM_DATA:
+        snapshots[writeSnapshot].data[streamOffset++] = b;
+        streamPacketLeft--;
+        streamRemaining--;
+        if (streamRemaining == 0) {
+            streamState = STREAM_CHECKSUM;
+        } else if (streamPacketLeft == 0) {
+            streamState = STREAM_ID;
+        }
+        break;
+    case STREAM_CHECKSUM:
+        // All bytes of a good frame add up to 0
+        if (streamChecksum == 0) {
+            publishGroup(0);
+        }
+        streamState = STREAM_HEADER;
+        break;
+    }
+}
 
 void requestPacket(uint8_t packetId) {
     byteTx(CmdSensors);
@@ -26,42 +248,194 @@ ISR(USART_RX_vect) {
     // Cache the retrieved byte
     uint8_t tmpUDR0;
     tmpUDR0 = UDR0;
-    // Don't do anything if we're not looking
-    if (usartActive) {
+    if (streaming) {
+        if (getSerialDestination() == SERIAL_CREATE) {
+            streamParse(tmpUDR0);
+        } else {
+            // Input from the computer; resync on the next frame
+            streamState = STREAM_HEADER;
+        }
+    } else if (usartActive) {
+        // Only store polled data when we're looking for it
         if (getSerialDestination() == SERIAL_CREATE) {
             // New sensor data from the create
-            sensorBuffer[sensorIndex++] = tmpUDR0;
+            snapshots[writeSnapshot].data[sensorIndex++] = tmpUDR0;
         } else {
             // Probably input from the computer, loop old values around
-            sensorBuffer[sensorIndex] = sensors[sensorIndex];
+            snapshots[writeSnapshot].data[sensorIndex] =
+                newestSnapshot()->data[sensorIndex];
             sensorIndex++;
+            groupReplayed = 1;
         }
-        if (sensorIndex >= Sen6Size) {
-            // Reached end of sensor packet
+        if (sensorIndex >= sensorEnd) {
+            // Reached end of sensor group
+            publishGroup(activeGroup);
             usartActive = 0;
         }
     }
 }
 
 void updateSensors(void) {
-    // Don't do anything if sensors are still coming in
-    if (!usartActive) {
-        uint8_t i;
-        for (i = 0; i < Sen6Size; i++) {
-            // Copy in the sensor buffer so the most recent data is available
-            sensors[i] = sensorBuffer[i];
+    // Make the most recent data available
+    sensorSnapshot();
+    sensingPoll();
+}
+
+void sensingPoll(void) {
+    // Nothing to do if the Create is streaming or sensors are still coming in
+    if (streaming || usartActive) {
+        return;
+    }
+    if (sensorGroupCount == 0) {
+#if SENSOR_BUFFER_SIZE >= Sen6Size
+        // Nothing declared; poll everything like we always have
+        if (!sensingGroupAdd(allPackets, 1, 0)) {
+            return;
         }
-        // Bookkeeping
-        sensorIndex = 0;
-        usartActive = 1;
-        // Request all sensor data
-        requestPacket(PACKET_ALL);
+        sensorFallback = 1;
+#else
+        // Can't happen after irobInit (see sensingGroups)
+        return;
+#endif
+    }
+    // Take turns between the groups that are due, starting after the last
+    uint16_t now = (uint16_t)millis();
+    uint8_t i;
+    uint8_t group = activeGroup;
+    for (i = 0; i < sensorGroupCount; i++) {
+        group++;
+        if (group >= sensorGroupCount) {
+            group = 0;
+        }
+        SensorGroup* g = &sensorGroups[group];
+        if ((uint16_t)(now - g->lastPoll_ms) >= g->period_ms) {
+            // Bookkeeping
+            g->lastPoll_ms = now;
+            activeGroup = group;
+            sensorIndex = g->base;
+            sensorEnd = g->base + g->size;
+            usartActive = 1;
+            // Request the whole group at once
+            uint8_t j;
+            byteTx(CmdSensorList);
+            byteTx(g->count);
+            for (j = 0; j < g->count; j++) {
+                byteTx(g->packetIds[j]);
+            }
+            return;
+        }
+    }
+}
+
+uint8_t sensingGroupAdd(const uint8_t* packetIds, uint8_t count,
+        uint16_t period_ms) {
+    uint8_t i;
+#if SENSOR_BUFFER_SIZE >= Sen6Size
+    if (sensorFallback) {
+        // Make way for the groups actually wanted
+        sensingGroupsClear();
+    }
+#endif
+    if (sensorGroupCount >= SENSOR_MAX_GROUPS) {
+        return 0;
+    }
+    // Make room for the group's packets
+    uint8_t base = sensorBufferUsed;
+    for (i = 0; i < count; i++) {
+        if (packetIds[i] > PACKET_MAX || !layoutPacket(packetIds[i])) {
+            // Doesn't fit; forget the whole group
+            sensorBufferUsed = base;
+            return 0;
+        }
+    }
+    SensorGroup* g = &sensorGroups[sensorGroupCount];
+    g->packetIds = packetIds;
+    g->count = count;
+    g->base = base;
+    g->size = sensorBufferUsed - base;
+    g->period_ms = period_ms;
+    // Due right away
+    g->lastPoll_ms = (uint16_t)millis() - period_ms;
+    sensorGroupCount++;
+    return 1;
+}
+
+uint8_t sensingGroups(void) {
+#if SENSOR_BUFFER_SIZE >= Sen6Size
+    if (sensorFallback) {
+        return 0;
+    }
+#endif
+    return sensorGroupCount;
+}
+
+void sensingGroupsClear(void) {
+    uint8_t i;
+    // Let any polled group finish first
+    waitForSensors();
+    activeGroup = 0;
+    sensorGroupCount = 0;
+    sensorBufferUsed = 0;
+#if SENSOR_BUFFER_SIZE >= Sen6Size
+    sensorFallback = 0;
+#endif
+    for (i = 0; i <= PACKET_MAX - PACKET_MIN_SINGLE; i++) {
+        packetSlots[i] = 0;
+    }
+}
+
+void sensingStreamStart(const uint8_t* packetIds, uint8_t count) {
+    uint8_t i;
+    // Lay the packets out as the only group
+    streaming = 0;
+    sensingGroupsClear();
+    if (!sensingGroupAdd(packetIds, count, 0)) {
+        return;
+    }
+    streamState = STREAM_HEADER;
+    streaming = 1;
+    // Ask the Create to start streaming
+    byteTx(CmdStream);
+    byteTx(count);
+    for (i = 0; i < count; i++) {
+        byteTx(packetIds[i]);
+    }
+}
+
+void sensingStreamPause(void) {
+    byteTx(CmdPauseStream);
+    byteTx(StreamPause);
+    // Wait out a frame that might already be on the wire
+    txFlush();
+    delayMs(StreamPeriodMs);
+    streaming = 0;
+}
+
+void sensingStreamResume(void) {
+    if (sensorGroupCount) {
+        streamState = STREAM_HEADER;
+        streaming = 1;
+        byteTx(CmdPauseStream);
+        byteTx(StreamResume);
     }
 }
 
+void sensingStreamExpect(void) {
+    if (sensorGroupCount) {
+        streamState = STREAM_HEADER;
+        streaming = 1;
+    }
+}
+
+uint8_t sensingStreaming(void) {
+    return streaming;
+}
+
 void waitForSensors(void) {
     // Sensors data are coming in if usartActive is true
-    while(usartActive);
+    while(usartActive) {
+        timerIdle();
+    }
 }
 
 void delayAndUpdateSensors(uint32_t time_ms) {
@@ -69,9 +443,52 @@ void delayAndUpdateSensors(uint32_t time_ms) {
     delayMsFunc(time_ms, &updateSensors, 1, UPDATE_SENSOR_DELAY_CUTOFF);
 }
 
+const SensorSnapshot* sensorSnapshot(void) {
+    // Trade the snapshot we were reading for the latest one, if it's new
+    uint8_t sreg = SREG;
+    cli();
+    if (freshSnapshot) {
+        uint8_t tmp = readSnapshot;
+        readSnapshot = latestSnapshot;
+        latestSnapshot = tmp;
+        freshSnapshot = 0;
+    }
+    SREG = sreg;
+    return &snapshots[readSnapshot];
+}
+
+uint8_t sensorsFresh(void) {
+    return freshSnapshot;
+}
+
+uint32_t sensorAgeMs(void) {
+    return millis() - snapshots[readSnapshot].time_ms;
+}
+
+uint16_t sensorSequence(void) {
+    // The receive interrupt bumps it
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t sequence = snapshotSequence;
+    SREG = sreg;
+    return sequence;
+}
+
+uint8_t sensorSnapshotUint8(const SensorSnapshot* snapshot, uint8_t index) {
+    // Find where the value lives
+    uint8_t position = sensorPosition(index);
+    return position == NO_SLOT ? 0 : snapshot->data[position];
+}
+
+uint16_t sensorSnapshotUint16(const SensorSnapshot* snapshot, uint8_t index1) {
+    // Combine msB and lsB
+    return (sensorSnapshotUint8(snapshot, index1) << 8)
+        | sensorSnapshotUint8(snapshot, index1 + 1);
+}
+
 uint8_t getSensorUint8(uint8_t index) {
-    // Already in the right format
-    return sensors[index];
+    // Read the snapshot last picked up by updateSensors or sensorSnapshot
+    return sensorSnapshotUint8(&snapshots[readSnapshot], index);
 }
 
 int8_t getSensorInt8(uint8_t index) {
@@ -81,8 +498,7 @@ int8_t getSensorInt8(uint8_t index) {
 }
 
 uint16_t getSensorUint16(uint8_t index1) {
-    // Combine msB and lsB
-    return (sensors[index1] << 8) | sensors[index1 + 1];
+    return sensorSnapshotUint16(&snapshots[readSnapshot], index1);
 }
 
 int16_t getSensorInt16(uint8_t index1) {
@@ -0,0 +1,127 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stdint.h>
+#include "swuart.h"
+
+// CTC with OCR2A as top, and what OC2A does at the next compare match
+#define SWUART_MARK     (_BV(WGM21) | _BV(COM2A1) | _BV(COM2A0))
+#define SWUART_SPACE    (_BV(WGM21) | _BV(COM2A1))
+
+// Transmit ring buffer. Records are finished up to swuartHead, and only
+// those are sent; swuartOpen is the end of the one being written.
+volatile uint8_t swuartBuffer[SWUART_BUFFER_SIZE];
+volatile uint8_t swuartHead = 0;
+volatile uint8_t swuartTail = 0;
+uint8_t swuartOpen = 0;
+// The open record didn't fit and is being dropped
+uint8_t swuartOverflow = 0;
+uint16_t swuartDropCount = 0;
+
+// Byte being shifted out, and which bit was set up last: 0 is the start
+// bit, 1-8 the data bits and 9 the stop bit
+volatile uint8_t swuartByte;
+volatile uint8_t swuartBit;
+// A byte is on the wire
+volatile uint8_t swuartBusy = 0;
+
+ISR(TIMER2_COMPA_vect) {
+    // The bit set up last time just went out; set up the next one
+    if (swuartBit < 8) {
+        // Data, least significant bit first
+        TCCR2A = (swuartByte & 0x01) ? SWUART_MARK : SWUART_SPACE;
+        swuartByte >>= 1;
+        swuartBit++;
+    } else if (swuartBit == 8) {
+        // Stop bit
+        TCCR2A = SWUART_MARK;
+        swuartBit++;
+    } else if (swuartHead != swuartTail) {
+        // The stop bit is out; start the next byte right after it
+        swuartByte = swuartBuffer[swuartTail];
+        swuartTail = (swuartTail + 1) & SWUART_BUFFER_MASK;
+        TCCR2A = SWUART_SPACE;
+        swuartBit = 0;
+    } else {
+        // Nothing left; the line stays marking until swuartPut
+        TIMSK2 &= ~_BV(OCIE2A);
+        swuartBusy = 0;
+    }
+}
+
+void swuartInit(void) {
+    // Idle high, and let the compare unit drive the pin from now on
+    PORTB |= _BV(PB3);
+    DDRB |= _BV(DDB3);
+    TCCR2A = SWUART_MARK;
+    TCCR2B = SWUART_CLOCK_SELECT;
+    OCR2A = SWUART_COUNTS - 1;
+    TCNT2 = 0;
+    swuartHead = 0;
+    swuartTail = 0;
+    swuartOpen = 0;
+    swuartOverflow = 0;
+    swuartBusy = 0;
+    swuartDropCount = 0;
+}
+
+// Add a byte to the open record, and send the record if it ends it
+void swuartAppend(uint8_t value, uint8_t ends) {
+    if (!swuartOverflow) {
+        uint8_t next = (swuartOpen + 1) & SWUART_BUFFER_MASK;
+        if (next == swuartTail) {
+            // Throw away what we have of this record
+            swuartOverflow = 1;
+            swuartOpen = swuartHead;
+        } else {
+            swuartBuffer[swuartOpen] = value;
+            swuartOpen = next;
+        }
+    }
+    if (!ends) {
+        return;
+    }
+    if (swuartOverflow) {
+        swuartDropCount++;
+        swuartOverflow = 0;
+        return;
+    }
+    uint8_t sreg = SREG;
+    cli();
+    swuartHead = swuartOpen;
+    if (!swuartBusy) {
+        // Idle: the start bit goes out at the next compare match. Clear a
+        // stale match first, or the interrupt would fire right away and
+        // skip the start bit.
+        swuartByte = swuartBuffer[swuartTail];
+        swuartTail = (swuartTail + 1) & SWUART_BUFFER_MASK;
+        swuartBit = 0;
+        TCCR2A = SWUART_SPACE;
+        TIFR2 = _BV(OCF2A);
+        TIMSK2 |= _BV(OCIE2A);
+        swuartBusy = 1;
+    }
+    SREG = sreg;
+}
+
+void swuartPut(uint8_t value) {
+    swuartAppend(value, value == '\n');
+}
+
+void swuartPutFrame(uint8_t value) {
+    // Frames can hold any byte but 0, newlines included
+    swuartAppend(value, value == 0);
+}
+
+uint8_t swuartQueueDepth(void) {
+    return (swuartHead - swuartTail) & SWUART_BUFFER_MASK;
+}
+
+uint16_t swuartDropped(void) {
+    return swuartDropCount;
+}
+
+void swuartFlush(void) {
+    // The interrupt clears swuartBusy after the last stop bit. Needs
+    // interrupts on.
+    while (swuartBusy) ;
+}
@@ -0,0 +1,101 @@
+#ifndef INCLUDE_SWUART_H
+#define INCLUDE_SWUART_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stdint.h>
+
+// # SOFTWARE UART #
+// A transmit-only 8N1 serial port on OC2A (PB3), one of the ePort I/O
+// lines, for logging while the hardware USART stays on the Create. Timer 2
+// runs in CTC mode at the bit rate and its compare match sets or clears the
+// pin in hardware, so bit edges don't jitter when another interrupt delays
+// ours; the interrupt only has to pick the next bit within one bit time.
+// Hook a 3.3/5 V USB serial adapter's RX to the pin.
+//
+// Like the batched log in irobserial.h, it queues whole records: a line
+// through swuartPut, or a telemetry frame through swuartPutFrame. A record
+// goes out once it's finished, and one that doesn't fit is dropped whole,
+// so the reader never sees half a line.
+
+// Interrupts.
+ISR(TIMER2_COMPA_vect);
+
+#ifndef F_CPU
+#error "F_CPU must be defined (see CDEFS in the Makefile)"
+#endif
+
+// Bit rate of the software UART
+#ifndef SWUART_BAUD
+#define SWUART_BAUD         (57600)
+#endif
+
+// Size of the transmit ring buffer. Must be a power of two. It has to hold
+// the longest record, and what's logged in one tick to not drop any: the
+// default fits lib4's binary telemetry (18 bytes a tick), but text logging
+// needs 128.
+#ifndef SWUART_BUFFER_SIZE
+#define SWUART_BUFFER_SIZE  (32)
+#endif
+#define SWUART_BUFFER_MASK  (SWUART_BUFFER_SIZE - 1)
+#if SWUART_BUFFER_SIZE & SWUART_BUFFER_MASK
+#error "SWUART_BUFFER_SIZE must be a power of two"
+#endif
+
+// Timer 2 counts per bit for a prescaler, rounded to nearest
+#define SWUART_COUNTS_FOR(prescale) \
+    ((F_CPU + (prescale) * SWUART_BAUD / 2) / ((prescale) * SWUART_BAUD))
+
+// Pick the smallest prescaler (finest resolution) whose count fits 8 bits
+#if SWUART_COUNTS_FOR(1) <= 0x100
+#define SWUART_PRESCALE     (1)
+#define SWUART_CLOCK_SELECT (_BV(CS20))
+#elif SWUART_COUNTS_FOR(8) <= 0x100
+#define SWUART_PRESCALE     (8)
+#define SWUART_CLOCK_SELECT (_BV(CS21))
+#elif SWUART_COUNTS_FOR(32) <= 0x100
+#define SWUART_PRESCALE     (32)
+#define SWUART_CLOCK_SELECT (_BV(CS21) | _BV(CS20))
+#else
+#define SWUART_PRESCALE     (64)
+#define SWUART_CLOCK_SELECT (_BV(CS22))
+#endif
+
+#define SWUART_COUNTS       (SWUART_COUNTS_FOR(SWUART_PRESCALE))
+
+#if SWUART_COUNTS > 0x100 || SWUART_COUNTS < 2
+#error "SWUART_BAUD can't be made with Timer 2 at this F_CPU"
+#endif
+// Same 2% a receiver tolerates from the hardware USART
+#if SWUART_PRESCALE * SWUART_COUNTS * 50L > F_CPU / SWUART_BAUD * 51L \
+    || SWUART_PRESCALE * SWUART_COUNTS * 50L < F_CPU / SWUART_BAUD * 49L
+#error "SWUART_BAUD can't be made within 2% at this F_CPU"
+#endif
+
+//! Start Timer 2 and drive the pin high (idle).
+/*!
+ *  Called by lib code that logs; Timer 2 and PB3 aren't used otherwise.
+ */
+void swuartInit(void);
+
+//! Queue a byte of text and return immediately. A newline ends the record.
+/*!
+ *  Never blocks: if the buffer fills, the record is dropped and counted, so
+ *  logging can't stall the control loop.
+ *  \param value        The byte to send.
+ */
+void swuartPut(uint8_t value);
+
+//! Same for telemetry. Only the 0 ending a frame ends the record.
+void swuartPutFrame(uint8_t value);
+
+//! Number of bytes waiting to be sent.
+uint8_t swuartQueueDepth(void);
+
+//! Records dropped because the buffer was full, since swuartInit.
+uint16_t swuartDropped(void);
+
+//! Wait until every queued byte has left the pin.
+void swuartFlush(void);
+
+#endif
@@ -0,0 +1,78 @@
+#include <stdint.h>
+#include <util/crc16.h>
+#include "telemetry.h"
+#include "irobserial.h"
+#include "timer.h"
+
+// The record being built, and how much of it there is. A length past
+// TELEMETRY_MAX_SIZE marks a record that overflowed.
+uint8_t telemetryRecord[TELEMETRY_MAX_SIZE + 1];
+uint8_t telemetryLength = 0;
+uint16_t telemetryDropCount = 0;
+
+void telemetryBegin(uint8_t id) {
+    telemetryLength = 0;
+    telemetryU8(id);
+    telemetryU16((uint16_t)millis());
+}
+
+void telemetryU8(uint8_t value) {
+    if (telemetryLength < TELEMETRY_MAX_SIZE) {
+        telemetryRecord[telemetryLength] = value;
+    }
+    // Keep counting past the end so telemetryEnd knows
+    if (telemetryLength <= TELEMETRY_MAX_SIZE) {
+        telemetryLength++;
+    }
+}
+
+void telemetryU16(uint16_t value) {
+    telemetryU8(value);
+    telemetryU8(value >> 8);
+}
+
+void telemetryI16(int16_t value) {
+    telemetryU16(value);
+}
+
+void telemetryU32(uint32_t value) {
+    telemetryU16(value);
+    telemetryU16(value >> 16);
+}
+
+void telemetryEnd(void) {
+    uint8_t length = telemetryLength;
+    uint8_t i;
+    if (length > TELEMETRY_MAX_SIZE) {
+        telemetryDropCount++;
+        return;
+    }
+    // CRC over id, time and fields, sent as the last byte
+    uint8_t crc = 0;
+    for (i = 0; i < length; i++) {
+        crc = _crc8_ccitt_update(crc, telemetryRecord[i]);
+    }
+    telemetryRecord[length++] = crc;
+    // COBS: each block of non-zero bytes is sent after a code byte holding
+    // its length + 1, and the zero after it is left out. The end of the
+    // record counts as one last zero.
+    i = 0;
+    while (i <= length) {
+        uint8_t end = i;
+        while (end < length && telemetryRecord[end] != 0) {
+            end++;
+        }
+        irobPutChar(end - i + 1);
+        while (i < end) {
+            irobPutChar(telemetryRecord[i++]);
+        }
+        // Skip the zero
+        i++;
+    }
+    // Frame delimiter
+    irobPutChar(0);
+}
+
+uint16_t telemetryDropped(void) {
+    return telemetryDropCount;
+}
@@ -0,0 +1,105 @@
+#include <stdint.h>
+#include "irobcmd.h"
+#include "cmod.h"
+#include "oi.h"
+
+// A drive command as it goes over the wire.
+typedef struct {
+    uint8_t opcode;
+    uint16_t arg1;
+    uint16_t arg2;
+} DriveFrame;
+
+// An led command as it goes over the wire.
+typedef struct {
+    uint8_t bits;
+    uint8_t color;
+    uint8_t intensity;
+} LedsFrame;
+
+// What is waiting to be sent.
+DriveFrame stagedDrive;
+LedsFrame stagedLeds;
+uint8_t driveStaged = 0;
+uint8_t ledsStaged = 0;
+
+// What the Create was last told.
+DriveFrame sentDrive;
+LedsFrame sentLeds;
+uint8_t driveValid = 0;
+uint8_t ledsValid = 0;
+
+// Link statistics
+uint32_t stagedBytes = 0;
+uint32_t sentBytes = 0;
+
+void irobcmdDrive(uint8_t opcode, uint16_t arg1, uint16_t arg2) {
+    // Overwrite anything staged earlier in this tick
+    stagedDrive.opcode = opcode;
+    stagedDrive.arg1 = arg1;
+    stagedDrive.arg2 = arg2;
+    driveStaged = 1;
+    stagedBytes += IROBCMD_DRIVE_SIZE;
+}
+
+void irobcmdLeds(uint8_t bits, uint8_t color, uint8_t intensity) {
+    // Overwrite anything staged earlier in this tick
+    stagedLeds.bits = bits;
+    stagedLeds.color = color;
+    stagedLeds.intensity = intensity;
+    ledsStaged = 1;
+    stagedBytes += IROBCMD_LEDS_SIZE;
+}
+
+void irobcmdFlush(void) {
+    irobcmdFlushDrive();
+    irobcmdFlushLeds();
+}
+
+void irobcmdFlushDrive(void) {
+    if (driveStaged) {
+        driveStaged = 0;
+        // Only send if the Create isn't already doing this
+        if (!driveValid || stagedDrive.opcode != sentDrive.opcode
+                || stagedDrive.arg1 != sentDrive.arg1
+                || stagedDrive.arg2 != sentDrive.arg2) {
+            byteTx(stagedDrive.opcode);
+            uint16Tx(stagedDrive.arg1);
+            uint16Tx(stagedDrive.arg2);
+            sentDrive = stagedDrive;
+            driveValid = 1;
+            sentBytes += IROBCMD_DRIVE_SIZE;
+        }
+    }
+}
+
+void irobcmdFlushLeds(void) {
+    if (ledsStaged) {
+        ledsStaged = 0;
+        // Only send if the leds would actually change
+        if (!ledsValid || stagedLeds.bits != sentLeds.bits
+                || stagedLeds.color != sentLeds.color
+                || stagedLeds.intensity != sentLeds.intensity) {
+            byteTx(CmdLeds);
+            byteTx(stagedLeds.bits);
+            byteTx(stagedLeds.color);
+            byteTx(stagedLeds.intensity);
+            sentLeds = stagedLeds;
+            ledsValid = 1;
+            sentBytes += IROBCMD_LEDS_SIZE;
+        }
+    }
+}
+
+void irobcmdInvalidate(void) {
+    driveValid = 0;
+    ledsValid = 0;
+}
+
+uint32_t irobcmdSentBytes(void) {
+    return sentBytes;
+}
+
+uint32_t irobcmdSuppressedBytes(void) {
+    return stagedBytes - sentBytes;
+}
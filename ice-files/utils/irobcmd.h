@@ -0,0 +1,47 @@
+#ifndef IROBCMD_H
+#define IROBCMD_H
+
+#include <stdint.h>
+
+/*
+ *  Staging layer for the Create's stateful commands (drive and leds).
+ *
+ *  driving.c and irobled.c stage their commands here instead of sending them.
+ *  irobcmdFlush sends whatever is staged, but only the parts that differ from
+ *  what the Create was last told, so repeated identical commands never reach
+ *  the serial link. irobPeriodic flushes once per tick.
+ */
+
+// Sizes of the staged frames in bytes, including the opcode.
+#define IROBCMD_DRIVE_SIZE  (5)
+#define IROBCMD_LEDS_SIZE   (4)
+
+//! Stage a drive command (CmdDrive or CmdDriveWheels) with its two arguments.
+void irobcmdDrive(uint8_t opcode, uint16_t arg1, uint16_t arg2);
+
+//! Stage an led command.
+void irobcmdLeds(uint8_t bits, uint8_t color, uint8_t intensity);
+
+//! Send the staged commands that differ from the last ones sent.
+void irobcmdFlush(void);
+
+//! Same for just the drive command.
+void irobcmdFlushDrive(void);
+
+//! Same for just the led command, leaving any drive command staged.
+void irobcmdFlushLeds(void);
+
+//! Forget what was last sent, so the next flush sends everything staged.
+/*!
+ *  Call this after anything that changes the Create's state behind the
+ *  staging layer's back (mode changes, scripts, resets).
+ */
+void irobcmdInvalidate(void);
+
+//! Bytes actually sent by irobcmdFlush.
+uint32_t irobcmdSentBytes(void);
+
+//! Bytes staged but never sent because they were redundant or overwritten.
+uint32_t irobcmdSuppressedBytes(void);
+
+#endif
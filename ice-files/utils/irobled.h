@@ -14,10 +14,31 @@
 #define ADVANCE_ROBOT_LED (0x08)
 #define BOTH_ROBOT_LED    (0x0A)
 
-//! Send an led command to the Create.
+//! Stage an led command for the Create. Sent by the next irobcmdFlush.
 void irobledCmd(uint8_t bits, uint8_t color, uint8_t intensity);
 //! Update the leds. Probably won't have to use.
+/*!
+ *  Stages the current state, or just marks it dirty in deferred mode.
+ */
 void irobledUpdate(void);
+
+//! Turn deferred mode on or off.
+/*!
+ *  In deferred mode the setters below only change the led state; nothing is
+ *  staged until irobledFlush, so a tick that rebuilds the leds piece by
+ *  piece sends at most one led command. irobPeriodic flushes every tick.
+ *  Turning it off flushes.
+ */
+void irobledDefer(uint8_t on);
+
+//! Send the led state if it changed since it was last flushed.
+/*!
+ *  Stages it and calls irobcmdFlushLeds, which sends it unless the Create
+ *  already shows it. A staged drive command is left for irobcmdFlush. While
+ *  a script is playing (see irobscript.h) nothing is sent and the state
+ *  stays dirty until the next flush after it.
+ */
+void irobledFlush(void);
 //! Initialize the leds to red for power and off for the others.
 void irobledInit(void);
 
@@ -1,6 +1,8 @@
 #ifndef IROBLIFE_H
 #define IROBLIFE_H
 
+#include <stdint.h>
+
 /*
  *  The irobPeriodic function in this library calls a function given to
  *  setIrobPeriodicImpl. The default value does nothing, but you can give
@@ -17,10 +19,27 @@ void setIrobPeriodicImpl(void (*func)(void));
 void setIrobEndImpl(void (*func)(void));
 
 //! Initialize the Create. Call this at the beginning of your main.
+//! Ends the program (irobEnd) if SENSOR_BUFFER_SIZE is too small to poll
+//! every sensor and the init function declared no sensor groups.
 void irobInit(void);
 //! Periodic operations. Call this in your main loop.
 //! Calls the function last given to setIrobPeriodicImpl.
 void irobPeriodic(void);
+//! Sensor-synchronous periodic operations. Call this in your main loop
+//! instead of irobPeriodic and a delay.
+/*!
+ *  Waits for a fresh sensor snapshot (polling sensor groups if the Create
+ *  isn't streaming, and running sched.h tasks), picks it up, then calls
+ *  irobPeriodic right away, so the periodic function always acts on data
+ *  that just arrived. The loop then runs at the sensor rate (every 15 ms
+ *  when streaming).
+ */
+void irobPeriodicSync(void);
+//! Milliseconds from the last tick's sensor data arriving to its drive and
+//! led commands being sent.
+uint16_t irobLatencyMs(void);
+//! Worst irobLatencyMs seen so far.
+uint16_t irobMaxLatencyMs(void);
 //! Stops and shuts down the Create, then exits. Call this to end the program.
 void irobEnd(void);
 
@@ -1,6 +1,5 @@
 #include <stdint.h>
-#include <stdarg.h>
-#include <stdio.h>
+#include <avr/pgmspace.h>
 #include "irobserial.h"
 #include "cmod.h"
 #include "oi.h"
@@ -13,7 +12,7 @@ void setSerialDestination(uint8_t dest) {
     // Which serial port should byteTx and byteRx talk to?
     // Ensure any pending bytes have been sent. Without this, the last byte
     // sent before calling this might seem to disappear.
-    delayMs(10);
+    txFlush();
     // Configure the port.
     if (dest == SERIAL_CREATE) {
         PORTB &= ~0x10 ;
@@ -41,28 +40,155 @@ void irobprint(char* str) {
     }
 }
 
-char printfBuffer[PRINTF_BUFFER_SIZE];
-
-void irobprintf(const char* format, ...) {
-    char* fp = &printfBuffer[0];
-    va_list ap;
-    va_start(ap, format);
-    // Format the string
-    vsnprintf(fp, PRINTF_BUFFER_SIZE, format, ap);
-    va_end(ap);
-    // Print the string
-    irobprint(fp);
-}
-
-void irobnprintf(uint16_t size, const char* format, ...) {
-    // Create a buffer
-    char formatted[size];
-    char* fp = &formatted[0];
-    va_list ap;
-    va_start(ap, format);
-    // Format the string
-    vsnprintf(fp, size, format, ap);
-    va_end(ap);
-    // Print the string
-    irobprint(fp);
+// Powers of ten for printing decimals by subtraction, which beats the
+// software division on the AVR
+const uint16_t putPowers[4] PROGMEM = { 10000, 1000, 100, 10 };
+
+// Where the irobPut functions send their characters
+void (*putTx)(uint8_t value) = &byteTx;
+
+void setPutTxImpl(void (*func)(uint8_t value)) {
+    putTx = func;
+}
+
+void irobPutStrP(const char* str) {
+    char c;
+    // Null-terminated string in flash
+    while ((c = pgm_read_byte(str++)) != '\0') {
+        putTx(c);
+    }
+}
+
+void irobPutChar(char c) {
+    putTx(c);
+}
+
+void irobPutU16(uint16_t value) {
+    uint8_t i;
+    uint8_t started = 0;
+    for (i = 0; i < 4; i++) {
+        uint16_t power = pgm_read_word(&putPowers[i]);
+        char digit = '0';
+        while (value >= power) {
+            value -= power;
+            digit++;
+        }
+        // Skip leading zeros
+        if (started || digit != '0') {
+            putTx(digit);
+            started = 1;
+        }
+    }
+    putTx('0' + value);
+}
+
+void irobPutI16(int16_t value) {
+    if (value < 0) {
+        putTx('-');
+        // Works for -32768 too, as an unsigned
+        irobPutU16(-(uint16_t)value);
+    } else {
+        irobPutU16(value);
+    }
+}
+
+void irobPutHex(uint16_t value, uint8_t digits) {
+    while (digits--) {
+        uint8_t nibble = (value >> (digits << 2)) & 0x0F;
+        putTx(nibble < 10 ? '0' + nibble : 'A' - 10 + nibble);
+    }
+}
+
+// Batched log. Records are finished up to logHead; logOpen is the end of the
+// one being written.
+uint8_t logBuffer[LOG_BUFFER_SIZE];
+uint8_t logHead = 0;
+uint8_t logOpen = 0;
+uint8_t logTail = 0;
+// The open record didn't fit and is being dropped
+uint8_t logOverflow = 0;
+uint16_t logDropCount = 0;
+uint16_t logSwitchCount = 0;
+uint32_t logSinceMs = 0;
+
+// Add a byte to the open record, and finish the record if it ends it
+void logAppend(uint8_t value, uint8_t ends) {
+    if (!logOverflow) {
+        uint8_t next = (logOpen + 1) & LOG_BUFFER_MASK;
+        if (next == logTail) {
+            // Throw away what we have of this record
+            logOverflow = 1;
+            logOpen = logHead;
+        } else {
+            logBuffer[logOpen] = value;
+            logOpen = next;
+        }
+    }
+    if (ends) {
+        if (logOverflow) {
+            logDropCount++;
+            logOverflow = 0;
+        } else {
+            logHead = logOpen;
+        }
+    }
+}
+
+void logPut(uint8_t value) {
+    logAppend(value, value == '\n');
+}
+
+void logPutFrame(uint8_t value) {
+    // Frames can hold any byte but 0, newlines included
+    logAppend(value, value == 0);
+}
+
+void logService(void) {
+    if (logDepth() >= LOG_HIGH_WATER) {
+        logDrain();
+    }
+}
+
+void logDrain(void) {
+    if (logHead == logTail) {
+        return;
+    }
+    uint8_t dest = getSerialDestination();
+    if (dest != SERIAL_USB) {
+        setSerialDestination(SERIAL_USB);
+    }
+    while (logTail != logHead) {
+        byteTx(logBuffer[logTail]);
+        logTail = (logTail + 1) & LOG_BUFFER_MASK;
+    }
+    if (dest != SERIAL_USB) {
+        setSerialDestination(SERIAL_CREATE);
+        logSwitchCount++;
+    }
+}
+
+uint8_t logDepth(void) {
+    return (logHead - logTail) & LOG_BUFFER_MASK;
+}
+
+uint16_t logDropped(void) {
+    return logDropCount;
+}
+
+uint16_t logSwitchesPerMinute(void) {
+    uint32_t elapsed_ms = millis() - logSinceMs;
+    if (elapsed_ms == 0) {
+        return 0;
+    }
+    return (uint32_t)logSwitchCount * 60000 / elapsed_ms;
+}
+
+void logReset(void) {
+    logHead = 0;
+    logOpen = 0;
+    logTail = 0;
+    logOverflow = 0;
+    logDropCount = 0;
+    logSwitchCount = 0;
+    logSinceMs = millis();
 }
@@ -2,14 +2,12 @@
 #define IROBSERIAL_H
 
 #include <stdint.h>
-#include <stdarg.h>
+#include <avr/pgmspace.h>
 
 #define SERIAL_CREATE       (1)
 #define SERIAL_USB          (2)
 #define SERIAL_SWITCHING    (0xFF)
 
-#define PRINTF_BUFFER_SIZE  (0xFF)
-
 //! Set the serial output (CREATE or USB)
 //! Takes some time.
 void setSerialDestination(uint8_t dest);
@@ -20,10 +18,93 @@ uint8_t getSerialDestination(void);
 //! Print a string
 void irobprint(char* str);
 
-//! Print a formatted string (Max length: 255 bytes)
-void irobprintf(const char* format, ...);
+// # FORMATTING #
+// Everything goes straight to byteTx, or whatever setPutTxImpl gave; there is
+// no buffer and no printf.
+
+//! Send the irobPut output somewhere other than byteTx.
+/*!
+ *  \param func         Takes one byte, e.g. swuartPut to log on the software
+ *                      UART without touching the Create link.
+ */
+void setPutTxImpl(void (*func)(uint8_t value));
+
+//! Print a string from flash.
+/*!
+ *  \param str          A PROGMEM string, e.g. PSTR("etk: ").
+ */
+void irobPutStrP(const char* str);
+
+//! Print a string literal, kept in flash.
+#define irobPutLit(str)     irobPutStrP(PSTR(str))
+
+//! Print a character.
+void irobPutChar(char c);
+
+//! Print an unsigned number in decimal.
+void irobPutU16(uint16_t value);
+
+//! Print a signed number in decimal.
+void irobPutI16(int16_t value);
+
+//! Print a number in hex.
+/*!
+ *  \param value        The number.
+ *  \param digits       How many (least significant) hex digits to print,
+ *                      1-4.
+ */
+void irobPutHex(uint16_t value, uint8_t digits);
+
+// # BATCHED LOG #
+// Logging through the shared USART costs a 20 ms switch each way. Instead,
+// setPutTxImpl(&logPut) collects whole lines in RAM while the USART stays on
+// the Create, and logService or logDrain sends them all to USB in one
+// switch. A record that doesn't fit is dropped whole. For binary telemetry
+// use setPutTxImpl(&logPutFrame) instead, so records are whole frames.
+
+// Size of the log ring. Must be a power of two, at most 256. With the drain
+// at LOG_HIGH_WATER, it should hold a few ticks of log so batches are worth
+// the switch.
+#ifndef LOG_BUFFER_SIZE
+#define LOG_BUFFER_SIZE     (128)
+#endif
+#define LOG_BUFFER_MASK     (LOG_BUFFER_SIZE - 1)
+#if LOG_BUFFER_SIZE & LOG_BUFFER_MASK || LOG_BUFFER_SIZE > 256
+#error "LOG_BUFFER_SIZE must be a power of two, at most 256"
+#endif
+
+// logService drains once this many bytes are waiting
+#ifndef LOG_HIGH_WATER
+#define LOG_HIGH_WATER      (LOG_BUFFER_SIZE * 3 / 4)
+#endif
+
+//! Add a byte to the log. A newline ends the record.
+void logPut(uint8_t value);
+
+//! Add a byte of telemetry to the log. Only the 0 ending a frame ends the
+//! record, since any other byte (a newline too) can be inside one.
+void logPutFrame(uint8_t value);
+
+//! Drain the log if it's past LOG_HIGH_WATER. Call it once a tick.
+void logService(void);
+
+//! Send every finished record to USB now, in one switch.
+/*!
+ *  Call it from an idle window (e.g. stopped on the dock), when 40 ms of
+ *  not hearing the Create doesn't matter. Does nothing if the log is empty.
+ */
+void logDrain(void);
+
+//! Bytes of finished records waiting to be sent.
+uint8_t logDepth(void);
+
+//! Records dropped because the log was full, since logReset.
+uint16_t logDropped(void);
+
+//! Trips to USB and back per minute, since logReset.
+uint16_t logSwitchesPerMinute(void);
 
-//! Print a formatted string (for strings longer than 255 bytes)
-void irobnprintf(uint16_t size, const char* format, ...);
+//! Empty the log and restart the counters.
+void logReset(void);
 
 #endif
@@ -0,0 +1,109 @@
+#include <stdint.h>
+#include "sched.h"
+#include "timer.h"
+
+// A registered task
+typedef struct {
+    void (*func)(void);
+    uint16_t period_ms;
+    uint16_t deadline_ms;
+    uint16_t cutoff_ms;
+    // When it should next start
+    uint16_t next_ms;
+    uint16_t overruns;
+    // Set while it runs, so a task that blocks doesn't run inside itself
+    uint8_t running;
+} Task;
+
+Task tasks[SCHED_MAX_TASKS];
+
+uint8_t schedAdd(void (*func)(void), uint16_t period_ms, uint16_t phase_ms,
+        uint16_t deadline_ms, uint16_t cutoff_ms) {
+    uint8_t i;
+    for (i = 0; i < SCHED_MAX_TASKS; i++) {
+        // Find an empty slot
+        if (tasks[i].func == 0) {
+            tasks[i].period_ms = period_ms;
+            tasks[i].deadline_ms = deadline_ms;
+            tasks[i].cutoff_ms = cutoff_ms;
+            tasks[i].next_ms = (uint16_t)millis() + phase_ms;
+            tasks[i].overruns = 0;
+            tasks[i].running = 0;
+            tasks[i].func = func;
+            return i;
+        }
+    }
+    return SCHED_NO_TASK;
+}
+
+void schedRemove(uint8_t task) {
+    if (task < SCHED_MAX_TASKS) {
+        tasks[task].func = 0;
+    }
+}
+
+uint16_t schedOverruns(uint8_t task) {
+    return task < SCHED_MAX_TASKS ? tasks[task].overruns : 0;
+}
+
+uint8_t schedStep(uint16_t remaining_ms) {
+    uint8_t i;
+    uint8_t ran = 0;
+    for (i = 0; i < SCHED_MAX_TASKS; i++) {
+        Task* t = &tasks[i];
+        if (t->func == 0 || t->running || t->cutoff_ms >= remaining_ms) {
+            continue;
+        }
+        uint16_t now = (uint16_t)millis();
+        uint16_t late = now - t->next_ms;
+        // Not due yet (the difference went "negative")
+        if (late & 0x8000) {
+            continue;
+        }
+        if (late > t->deadline_ms) {
+            t->overruns++;
+        }
+        // Schedule the next start, skipping (and counting) missed periods
+        if (t->period_ms == 0) {
+            t->next_ms = now;
+        } else {
+            t->next_ms += t->period_ms;
+            while (!((uint16_t)(now - t->next_ms) & 0x8000)) {
+                t->next_ms += t->period_ms;
+                t->overruns++;
+            }
+        }
+        // Run it
+        t->running = 1;
+        t->func();
+        t->running = 0;
+        ran = 1;
+    }
+    return ran;
+}
+
+void schedRunMs(uint32_t time_ms) {
+    schedRunMsPredicate(time_ms, 0);
+}
+
+void schedRunPredicate(uint8_t (*pred)(void)) {
+    while (pred()) {
+        if (!schedStep(SCHED_NO_CUTOFF)) {
+            // Nothing to do until the next interrupt
+            timerIdle();
+        }
+    }
+}
+
+void schedRunMsPredicate(uint32_t time_ms, uint8_t (*pred)(void)) {
+    uint32_t start = millis();
+    uint32_t elapsed;
+    while ((elapsed = millis() - start) < time_ms && (pred == 0 || pred())) {
+        uint32_t remaining = time_ms - elapsed;
+        if (!schedStep(remaining < SCHED_NO_CUTOFF
+                    ? remaining : SCHED_NO_CUTOFF)) {
+            // Nothing to do until the next interrupt
+            timerIdle();
+        }
+    }
+}
@@ -2,6 +2,7 @@
 #define SENSING_H
 
 #include <stdint.h>
+#include "oi.h"
 
 #define UPDATE_SENSOR_DELAY_PERIOD      (1)
 #define UPDATE_SENSOR_DELAY_CUTOFF      (10)
@@ -24,7 +25,46 @@
 #define IR_FORWARD                      (130)
 #define IR_RIGHT                        (131)
 
+#define PACKET_CLIFF_LEFT               (9)
+#define PACKET_CLIFF_FRONT_LEFT         (10)
+#define PACKET_CLIFF_FRONT_RIGHT        (11)
+#define PACKET_CLIFF_RIGHT              (12)
+#define PACKET_IR_CHAR                  (17)
+#define PACKET_DISTANCE                 (19)
+#define PACKET_ANGLE                    (20)
+#define PACKET_VOLTAGE                  (22)
+#define PACKET_CURRENT                  (23)
+#define PACKET_TEMPERATURE              (24)
+#define PACKET_CHARGE                   (25)
+#define PACKET_WALL_SIGNAL              (27)
+#define PACKET_CHARGING_SOURCES         (34)
+
 #define PACKET_ALL                      (6)
+// Lowest and highest single (non-group) packet IDs
+#define PACKET_MIN_SINGLE               (7)
+#define PACKET_MAX                      (42)
+
+// Bytes of sensor data kept. Sensor groups and streams only take room for
+// the packets they select; a project that never polls PACKET_ALL can shrink
+// this (e.g. -DSENSOR_BUFFER_SIZE=16 in CDEFS). It then has to declare its
+// groups or stream in irobInitImpl, as there's no room to poll everything
+// (irobInit stops otherwise).
+#ifndef SENSOR_BUFFER_SIZE
+#define SENSOR_BUFFER_SIZE              (Sen6Size)
+#endif
+
+// Most sensor groups that can be declared at once
+#define SENSOR_MAX_GROUPS               (4)
+
+//! A complete, consistent set of sensor values.
+typedef struct {
+    //! The selected packets' data, laid out by the sensor groups
+    uint8_t data[SENSOR_BUFFER_SIZE];
+    //! Counts up by one with every snapshot
+    uint16_t sequence;
+    //! millis() when the last of the data came in
+    uint32_t time_ms;
+} SensorSnapshot;
 
 //! Request a sensor packet. \see read1ByteSensorPacket(uint8_t)
 /*!
@@ -62,15 +102,111 @@ void requestPacket(uint8_t packetId);
  */
 uint8_t read1ByteSensorPacket(uint8_t packetId);
 
-//! Request all packets (will be retrieved by USART)
+//! Request the next due sensor group (will be retrieved by USART)
+/*!
+ *  Picks up the newest sensor snapshot, then requests the next
+ *  group whose period has passed. With no groups declared, all packets are
+ *  requested every time, until the first group is declared (only if
+ *  SENSOR_BUFFER_SIZE can hold them). Does nothing while streaming; the Create sends the
+ *  data on its own.
+ */
 void updateSensors(void);
 
+//! Request the next due sensor group, like updateSensors, without picking
+//! up a snapshot.
+/*!
+ *  For wait loops that watch sensorsFresh or sensorSequence: picking up a
+ *  snapshot there would hide the frame being waited for.
+ */
+void sensingPoll(void);
+
 //! Wait for all packets to be recieved by USART
 void waitForSensors(void);
 
 //! delayMs that updates sensors
 void delayAndUpdateSensors(uint32_t time_ms);
 
+//! Pick up the newest complete sensor snapshot.
+/*!
+ *  The snapshot stays intact (the receive interrupt never writes it) until
+ *  the next call to this or updateSensors, which also picks one up. The
+ *  getSensor functions read the snapshot picked up last.
+ */
+const SensorSnapshot* sensorSnapshot(void);
+
+//! Whether a snapshot newer than the one picked up last has come in.
+/*!
+ *  Set by the receive interrupt when a group or stream frame completes;
+ *  cleared by sensorSnapshot.
+ */
+uint8_t sensorsFresh(void);
+
+//! Milliseconds since the snapshot picked up last finished coming in.
+uint32_t sensorAgeMs(void);
+
+//! The sequence number of the latest snapshot to come in.
+uint16_t sensorSequence(void);
+
+//! Get an unsigned 1-byte value from a snapshot, by packet 6 index.
+uint8_t sensorSnapshotUint8(const SensorSnapshot* snapshot, uint8_t index);
+
+//! Get an unsigned 2-byte value from a snapshot, by packet 6 index of the
+//! more significant byte.
+uint16_t sensorSnapshotUint16(const SensorSnapshot* snapshot, uint8_t index1);
+
+//! Declare a group of sensor packets to poll at its own rate.
+/*!
+ *  updateSensors requests the whole group at once with the sensor list
+ *  command, at most once per period. When several are due, they take turns:
+ *  the search starts after the group polled last, so none is starved. Only
+ *  the selected packets take room in the sensor buffer; the getSensor
+ *  functions still take packet 6 indices (see oi.h) and return 0 for
+ *  packets no group selected.
+ *
+ *  \param packetIds    The IDs of the packets in the group (0-42). Must stay
+ *                      valid; it is not copied.
+ *  \param count        The number of packets.
+ *  \param period_ms    How often to poll the group. 0 polls it every time.
+ *  \return             1 if the group was added, 0 if there was no room.
+ */
+uint8_t sensingGroupAdd(const uint8_t* packetIds, uint8_t count,
+        uint16_t period_ms);
+
+//! Number of sensor groups declared, not counting polling everything.
+uint8_t sensingGroups(void);
+
+//! Forget all sensor groups (and stop polling anything).
+void sensingGroupsClear(void);
+
+//! Start streaming sensor packets from the Create.
+/*!
+ *  The Create sends the packets every 15 ms without being asked. The USART
+ *  receive interrupt checks each frame's checksum before publishing it.
+ *  Replaces any sensor groups; the packets are laid out as one group.
+ *
+ *  \param packetIds    The IDs of the packets to stream (0-42). Must stay
+ *                      valid; it is not copied.
+ *  \param count        The number of packets.
+ */
+void sensingStreamStart(const uint8_t* packetIds, uint8_t count);
+
+//! Pause the stream. updateSensors polls the same packets while paused.
+void sensingStreamPause(void);
+
+//! Resume the stream started by sensingStreamStart.
+void sensingStreamResume(void);
+
+//! Get ready for the Create to resume the stream on its own.
+/*!
+ *  For when the stream is paused and something other than
+ *  sensingStreamResume will resume it, such as the last command of a
+ *  script (see irobscript.h).
+ */
+void sensingStreamExpect(void);
+
+//! Whether the Create is currently streaming sensors to us.
+uint8_t sensingStreaming(void);
+
 //! Get an unsigned 1-byte sensor value
 uint8_t getSensorUint8(uint8_t index);
 
@@ -1,10 +1,68 @@
 #include <stdint.h>
+#include <avr/sleep.h>
 #include "timer.h"    // Declaration made available here
+#include "sched.h"
 
 
 // Timer variables defined here
-volatile uint32_t delayTimerCount = 0;   // Definition checked against declaration
-volatile uint8_t  delayTimerRunning = 0; // Definition checked against declaration
+volatile uint32_t timerMs = 0;           // Free-running millisecond count
+
+// Ticks into the current millisecond
+volatile uint8_t  timerSubTicks = 0;
+
+// Where the core was at each tick
+volatile uint8_t  timerSleeping = 0;
+volatile uint32_t idleTicks = 0;
+volatile uint32_t busyTicks = 0;
+
+// Marks a timer that is in no slot
+#define TIMER_NO_SLOT   (0xFF)
+// Marks a timer waiting in timerDeferred
+#define TIMER_DEFERRED  (0xFE)
+
+// Timer wheel: a list of timers per slot, and the slot for this millisecond
+SoftTimer* timerWheel[TIMER_WHEEL_SIZE];
+volatile uint8_t timerWheelIndex = 0;
+// The interrupt is walking this millisecond's slot
+uint8_t timerWalking = 0;
+// Timers (re)started into the slot being walked; they join it afterwards,
+// so they don't expire again in the same walk
+SoftTimer* timerDeferred = 0;
+
+// Put a timer in the wheel delay_ms from now. Interrupts must be off.
+void softTimerInsert(SoftTimer* timer, uint16_t delay_ms) {
+    if (delay_ms == 0) {
+        delay_ms = 1;
+    }
+    uint8_t slot = (timerWheelIndex + delay_ms) & TIMER_WHEEL_MASK;
+    timer->rounds = (delay_ms - 1) >> TIMER_WHEEL_SHIFT;
+    if (timerWalking && slot == timerWheelIndex) {
+        timer->slot = TIMER_DEFERRED;
+        timer->next = timerDeferred;
+        timerDeferred = timer;
+        return;
+    }
+    timer->slot = slot;
+    timer->next = timerWheel[slot];
+    timerWheel[slot] = timer;
+}
+
+// Take a timer out of the wheel. Interrupts must be off.
+void softTimerUnlink(SoftTimer* timer) {
+    if (timer->slot == TIMER_NO_SLOT) {
+        // Expiring right now; not in any slot
+        return;
+    }
+    SoftTimer** link = timer->slot == TIMER_DEFERRED
+        ? &timerDeferred : &timerWheel[timer->slot];
+    while (*link != 0) {
+        if (*link == timer) {
+            *link = timer->next;
+            return;
+        }
+        link = &(*link)->next;
+    }
+}
 
 
 // Chris -- moved to sensing.c
@@ -19,94 +77,223 @@ volatile uint8_t  delayTimerRunning = 0; // Definition checked against declarati
 
 //SIGNAL(SIG_OUTPUT_COMPARE1A)
 ISR(TIMER1_COMPA_vect) {
-    // Interrupt handler called every 1ms.
-    // Decrement the counter variable, to allow delayMs to keep time.
-    if(delayTimerCount != 0) {
-        delayTimerCount--;
+    // Interrupt handler called every tick (TIMER_TICK_US).
+    // Were we asleep when this tick woke us?
+    if (timerSleeping) {
+        idleTicks++;
     } else {
-        delayTimerRunning = 0;
+        busyTicks++;
+    }
+#if TIMER_TICKS_PER_MS > 1
+    // The rest only happens once a millisecond
+    if (++timerSubTicks < TIMER_TICKS_PER_MS) {
+        return;
+    }
+    timerSubTicks = 0;
+#endif
+    // Count up the clock.
+    timerMs++;
+    // Turn the timer wheel and look at this slot's timers only.
+    uint8_t slot = (timerWheelIndex + 1) & TIMER_WHEEL_MASK;
+    timerWheelIndex = slot;
+    SoftTimer** link = &timerWheel[slot];
+    timerWalking = 1;
+    while (*link != 0) {
+        SoftTimer* timer = *link;
+        if (timer->rounds != 0) {
+            // Not this time around
+            timer->rounds--;
+            link = &timer->next;
+            continue;
+        }
+        // Expired; take it out of the slot
+        *link = timer->next;
+        timer->slot = TIMER_NO_SLOT;
+        if (timer->expired != 0xFF) {
+            timer->expired++;
+        }
+        if (!timer->period_ms) {
+            timer->active = 0;
+        }
+        if (timer->callback) {
+            timer->callback();
+        }
+        if (timer->active && timer->slot == TIMER_NO_SLOT) {
+            // Periodic, and the callback didn't restart or stop it
+            softTimerInsert(timer, timer->period_ms);
+        }
+    }
+    timerWalking = 0;
+    // Now the timers restarted into this slot can join it
+    while (timerDeferred != 0) {
+        SoftTimer* timer = timerDeferred;
+        timerDeferred = timer->next;
+        timer->slot = slot;
+        timer->next = timerWheel[slot];
+        timerWheel[slot] = timer;
     }
 }
 
 void setupTimer(void) {
-    // Set up the timer 1 interupt to be called every 1ms.
-    // It's probably best to treat this as a black box.
-    // Basic idea: Except for the 71, these are special codes, for which details
-    // appear in the ATMega168 data sheet. The 71 is a computed value, based on
-    // the processor speed and the amount of "scaling" of the timer, that gives
-    // us the 1ms time interval.
+    // Set up the timer 1 interupt to be called every tick (1ms by default).
+    // Basic idea: count the (prescaled) clock up to TIMER_TOP, then reset and
+    // interrupt (CTC mode). timer.h works out the prescaler and TIMER_TOP from
+    // F_CPU and TIMER_TICK_US; details appear in the ATMega168 data sheet.
     TCCR1A = 0x00;
-    // TCCR1B = 0x0C;
-    TCCR1B = (_BV(WGM12) | _BV(CS12));
-    OCR1A = 71;
+    TCCR1B = (_BV(WGM12) | TIMER_CLOCK_SELECT);
+    OCR1A = TIMER_TOP;
     // TIMSK1 = 0x02;
     TIMSK1 = _BV(OCIE1A);
 }
 
+uint32_t millis(void) {
+    // The count is four bytes; don't let the interrupt change it mid-read
+    uint8_t sreg = SREG;
+    cli();
+    uint32_t ms = timerMs;
+    SREG = sreg;
+    return ms;
+}
+
+void timerIdle(void) {
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    timerSleeping = 1;
+    sleep_mode();
+    timerSleeping = 0;
+}
+
+uint32_t timerIdleMs(void) {
+    uint8_t sreg = SREG;
+    cli();
+    uint32_t ticks = idleTicks;
+    SREG = sreg;
+    return ticks / TIMER_TICKS_PER_MS;
+}
+
+uint32_t timerBusyMs(void) {
+    uint8_t sreg = SREG;
+    cli();
+    uint32_t ticks = busyTicks;
+    SREG = sreg;
+    return ticks / TIMER_TICKS_PER_MS;
+}
+
+uint32_t micros(void) {
+    // Read the clock, tick and timer together
+    uint8_t sreg = SREG;
+    cli();
+    uint32_t ms = timerMs;
+    uint16_t us = timerSubTicks * TIMER_TICK_US;
+    uint16_t counts = TCNT1;
+    if ((TIFR1 & _BV(OCF1A)) && counts < TIMER_TOP) {
+        // The timer wrapped after interrupts went off; count that tick
+        us += TIMER_TICK_US;
+    }
+    SREG = sreg;
+    return ms * 1000 + us
+        + (uint16_t)((counts * (uint32_t)TIMER_US_PER_COUNT_Q16) >> 16);
+}
+
+void softTimerStart(SoftTimer* timer, uint16_t delay_ms, uint16_t period_ms,
+        void (*callback)(void)) {
+    uint8_t sreg = SREG;
+    cli();
+    if (timer->active) {
+        softTimerUnlink(timer);
+    }
+    timer->callback = callback;
+    timer->period_ms = period_ms;
+    timer->expired = 0;
+    timer->active = 1;
+    softTimerInsert(timer, delay_ms);
+    SREG = sreg;
+}
+
+void softTimerStop(SoftTimer* timer) {
+    uint8_t sreg = SREG;
+    cli();
+    if (timer->active) {
+        softTimerUnlink(timer);
+        timer->active = 0;
+    }
+    SREG = sreg;
+}
+
+uint8_t softTimerExpired(SoftTimer* timer) {
+    uint8_t sreg = SREG;
+    cli();
+    uint8_t expired = timer->expired;
+    timer->expired = 0;
+    SREG = sreg;
+    return expired;
+}
+
 // Delay for the specified time in ms without updating sensor values
 void delayMs(uint32_t time_ms) {
-    delayTimerRunning = 1;
-    delayTimerCount = time_ms;
-    while(delayTimerRunning) ;
+    // Uses the free-running clock, so nested or concurrent delays are fine
+    uint32_t start = millis();
+    while (millis() - start < time_ms) {
+        timerIdle();
+    }
 }
 
-void delayMsFunc(uint32_t time_ms, void (*func)(void), uint16_t period_ms,
-        uint16_t cutoff_ms) {
-    // Initialize the conditions for the delay loop
-    uint32_t lastExec = time_ms;
-    uint32_t nextExec = lastExec - period_ms;
-    // Start the timer
-    delayTimerRunning = 1;
-    delayTimerCount = time_ms;
-    // Wait until the timer runs out (delayTimerCount decrements every ms)
-    while(delayTimerRunning) {
-        // If it's before the cutoff and time for the next execution
-        if (delayTimerCount > cutoff_ms && delayTimerCount <= nextExec) {
-            // Execute the function
-            lastExec = delayTimerCount;
-            nextExec = lastExec - period_ms;
+// What the delay*Func functions do when the task table has no room for
+// func: run tasks like schedRunMsPredicate, and call func every period_ms
+// from here
+void delayInlineFunc(uint32_t time_ms, uint8_t (*pred)(void),
+        void (*func)(void), uint16_t period_ms, uint16_t cutoff_ms) {
+    uint32_t start = millis();
+    uint32_t next_ms = period_ms;
+    uint32_t elapsed;
+    while ((elapsed = millis() - start) < time_ms && (pred == 0 || pred())) {
+        uint32_t remaining = time_ms - elapsed;
+        uint8_t ran = 0;
+        if (elapsed >= next_ms && remaining > cutoff_ms) {
+            next_ms = elapsed + period_ms;
             func();
+            ran = 1;
+        }
+        if (!schedStep(remaining < SCHED_NO_CUTOFF
+                    ? remaining : SCHED_NO_CUTOFF) && !ran) {
+            // Nothing to do until the next interrupt
+            timerIdle();
         }
     }
 }
 
+void delayMsFunc(uint32_t time_ms, void (*func)(void), uint16_t period_ms,
+        uint16_t cutoff_ms) {
+    // Run the function as a task for the length of the delay
+    uint8_t task = schedAdd(func, period_ms, period_ms, period_ms, cutoff_ms);
+    if (task == SCHED_NO_TASK) {
+        delayInlineFunc(time_ms, 0, func, period_ms, cutoff_ms);
+        return;
+    }
+    schedRunMs(time_ms);
+    schedRemove(task);
+}
+
 void delayPredicateFunc(uint8_t (*pred)(void), void (*func)(void),
         uint16_t period_ms, uint16_t cutoff_ms) {
-    // Initialize the conditions for the delay loop
-    uint32_t lastExec = 0xFFFFFFFF;
-    uint32_t nextExec = lastExec - period_ms;
-    // Start the timer
-    delayTimerRunning = 1;
-    delayTimerCount = 0xFFFFFFFF;
-    // Wait until the timer runs out (delayTimerCount decrements every ms)
-    while(pred()) {
-        // If it's before the cutoff and time for the next execution
-        if (delayTimerCount > cutoff_ms && delayTimerCount <= nextExec) {
-            // Execute the function
-            lastExec = delayTimerCount;
-            nextExec = lastExec - period_ms;
-            func();
-        }
+    // Run the function as a task until the predicate fails
+    uint8_t task = schedAdd(func, period_ms, period_ms, period_ms, cutoff_ms);
+    if (task == SCHED_NO_TASK) {
+        // No time limit (well, 49 days)
+        delayInlineFunc(0xFFFFFFFF, pred, func, period_ms, cutoff_ms);
+        return;
     }
-    delayMs(1);
+    schedRunPredicate(pred);
+    schedRemove(task);
 }
 
 void delayMsPredicateFunc(uint32_t time_ms, uint8_t (*pred)(void),
         void (*func)(void), uint16_t period_ms, uint16_t cutoff_ms) {
-    // Initialize the conditions for the delay loop
-    uint32_t lastExec = time_ms;
-    uint32_t nextExec = lastExec - period_ms;
-    // Start the timer
-    delayTimerRunning = 1;
-    delayTimerCount = time_ms;
-    // Wait until the timer runs out (delayTimerCount decrements every ms)
-    while(delayTimerRunning && pred()) {
-        // If it's before the cutoff and time for the next execution
-        if (delayTimerCount > cutoff_ms && delayTimerCount <= nextExec) {
-            // Execute the function
-            lastExec = delayTimerCount;
-            nextExec = lastExec - period_ms;
-            func();
-        }
+    // Run the function as a task for the delay or until the predicate fails
+    uint8_t task = schedAdd(func, period_ms, period_ms, period_ms, cutoff_ms);
+    if (task == SCHED_NO_TASK) {
+        delayInlineFunc(time_ms, pred, func, period_ms, cutoff_ms);
+        return;
     }
+    schedRunMsPredicate(time_ms, pred);
+    schedRemove(task);
 }
@@ -7,18 +7,142 @@
 // Interrupts.
 ISR(TIMER1_COMPA_vect);
 
+// # TICK CONFIGURATION #
+// Everything here is worked out at compile time from F_CPU and the requested
+// tick, so a faster tick (e.g. -DTIMER_TICK_US=250 in CDEFS) needs no magic
+// numbers. The millisecond clock and the timer wheel still run every ms.
+
+#ifndef F_CPU
+#error "F_CPU must be defined (see CDEFS in the Makefile)"
+#endif
+
+// Length of a timer interrupt tick in microseconds. Must divide 1000.
+#ifndef TIMER_TICK_US
+#define TIMER_TICK_US       (1000)
+#endif
+#if 1000 % TIMER_TICK_US != 0
+#error "TIMER_TICK_US must divide 1000"
+#endif
+#define TIMER_TICKS_PER_MS  (1000 / TIMER_TICK_US)
+#define TIMER_TICKS_PER_S   (1000000UL / TIMER_TICK_US)
+
+// Most the real tick may be off from TIMER_TICK_US, in parts per million
+#ifndef TIMER_MAX_ERROR_PPM
+#define TIMER_MAX_ERROR_PPM (500)
+#endif
+
+// Timer 1 counts per tick for a prescaler, rounded to nearest
+#define TIMER_COUNTS_FOR(prescale) \
+    ((F_CPU + (prescale) * TIMER_TICKS_PER_S / 2) \
+     / ((prescale) * TIMER_TICKS_PER_S))
+
+// Pick the smallest prescaler (finest resolution) whose count fits 16 bits
+#if TIMER_COUNTS_FOR(1) <= 0x10000
+#define TIMER_PRESCALE      (1)
+#define TIMER_CLOCK_SELECT  (_BV(CS10))
+#elif TIMER_COUNTS_FOR(8) <= 0x10000
+#define TIMER_PRESCALE      (8)
+#define TIMER_CLOCK_SELECT  (_BV(CS11))
+#elif TIMER_COUNTS_FOR(64) <= 0x10000
+#define TIMER_PRESCALE      (64)
+#define TIMER_CLOCK_SELECT  (_BV(CS11) | _BV(CS10))
+#elif TIMER_COUNTS_FOR(256) <= 0x10000
+#define TIMER_PRESCALE      (256)
+#define TIMER_CLOCK_SELECT  (_BV(CS12))
+#else
+#define TIMER_PRESCALE      (1024)
+#define TIMER_CLOCK_SELECT  (_BV(CS12) | _BV(CS10))
+#endif
+
+#define TIMER_COUNTS        (TIMER_COUNTS_FOR(TIMER_PRESCALE))
+#define TIMER_TOP           (TIMER_COUNTS - 1)
+
+#if TIMER_COUNTS > 0x10000 || TIMER_COUNTS < 2
+#error "TIMER_TICK_US can't be made with Timer 1 at this F_CPU"
+#endif
+#if TIMER_PRESCALE * TIMER_COUNTS * TIMER_TICKS_PER_S * 1000000 \
+        > F_CPU * (1000000 + TIMER_MAX_ERROR_PPM) \
+    || TIMER_PRESCALE * TIMER_COUNTS * TIMER_TICKS_PER_S * 1000000 \
+        < F_CPU * (1000000 - TIMER_MAX_ERROR_PPM)
+#error "Timer tick rounding error is more than TIMER_MAX_ERROR_PPM"
+#endif
+
+// Microseconds per timer count, in Q16 fixed point
+#define TIMER_US_PER_COUNT_Q16 \
+    ((TIMER_TICK_US * 65536UL + TIMER_COUNTS / 2) / TIMER_COUNTS)
+
 // Timer functions
 void setupTimer(void);
 void delayMs(uint32_t time_ms);
 
-// Declaration of timer variables
-extern volatile uint32_t delayTimerCount;
-extern volatile uint8_t  delayTimerRunning;
+//! Milliseconds since setupTimer. Wraps after about 49 days.
+uint32_t millis(void);
+
+//! Sleep (idle mode) until the next interrupt.
+/*!
+ *  The timer and USART keep running and wake the core, so this returns
+ *  within a tick. Use it in wait loops instead of spinning.
+ */
+void timerIdle(void);
+
+//! Milliseconds the core spent asleep in timerIdle (sampled every tick).
+uint32_t timerIdleMs(void);
+
+//! Milliseconds the core spent awake (sampled every tick).
+uint32_t timerBusyMs(void);
+
+//! Microseconds since setupTimer, to one timer count.
+//! Wraps after about 71 minutes.
+uint32_t micros(void);
+
+
+// # SOFTWARE TIMERS #
+
+// Slots in the timer wheel. Must be a power of two.
+#define TIMER_WHEEL_SIZE    (16)
+#define TIMER_WHEEL_MASK    (TIMER_WHEEL_SIZE - 1)
+#define TIMER_WHEEL_SHIFT   (4)
+
+//! A one-shot or periodic software timer. Allocate these yourself (globals).
+typedef struct SoftTimer {
+    struct SoftTimer* next;
+    //! Called from the timer interrupt on expiry, if not null. Keep it short.
+    void (*callback)(void);
+    //! 0 for a one-shot timer
+    uint16_t period_ms;
+    //! Times around the wheel left before it expires
+    uint16_t rounds;
+    uint8_t slot;
+    uint8_t active;
+    //! Expiries not yet collected by softTimerExpired
+    volatile uint8_t expired;
+} SoftTimer;
+
+//! Start (or restart) a software timer.
+/*!
+ *  Expiring a timer is O(1) in the timer interrupt: each millisecond only the
+ *  timers hashed to the current wheel slot are looked at.
+ *
+ *  \param timer        The timer.
+ *  \param delay_ms     Milliseconds until it first expires.
+ *  \param period_ms    Milliseconds between later expiries; 0 for one-shot.
+ *  \param callback     Called from the interrupt on expiry; may be null.
+ */
+void softTimerStart(SoftTimer* timer, uint16_t delay_ms, uint16_t period_ms,
+        void (*callback)(void));
+
+//! Stop a software timer.
+void softTimerStop(SoftTimer* timer);
+
+//! How many times the timer expired since the last call (saturates at 255).
+uint8_t softTimerExpired(SoftTimer* timer);
 
 //! Wait milliseconds, execute a function periodically.
 /*! 
  *  Executes a function at an interval until a cutoff has passed, returning
- *  after a total number of milliseconds have passed.
+ *  after a total number of milliseconds have passed. The function runs as a
+ *  temporary sched.h task, so other registered tasks keep running too. If
+ *  the task table is full, it is called from the delay loop instead.
  *
  *  \param time_ms      The total number of seconds to wait.
  *  \param func         The function to execute periodically.